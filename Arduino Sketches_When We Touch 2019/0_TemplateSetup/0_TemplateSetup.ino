@@ -6,6 +6,15 @@
 // #include <FreeStack.h> 
 // #include <SFEMP3Shield.h>
 
+// Some BtUtils features are switched off in BtUtils.h to save memory (see
+// the NOTE at the top of BtUtils-readme.htm). If this sketch uses one of
+// them, check for it here, so that it stops with a message that says
+// which switch to turn on instead of a long list of errors:
+
+// #if !BTUTILS_ENABLE_CALIBRATION
+// #error "This sketch needs #define BTUTILS_ENABLE_CALIBRATION 1 in BtUtils.h"
+// #endif
+
 SdFat sd;
 SFEMP3Shield MP3player;
 
@@ -51,6 +60,17 @@ void setup() {
   // be greater than release.
 
   // bt->setTouchReleaseThreshold(40, 20);
+
+
+  // Tune the touch pins to the electrodes connected to them; call it with
+  // nothing near the board. Needs BTUTILS_ENABLE_CALIBRATION (see above).
+
+  // bt->autoCalibrate();
+
+
+  // Resume each track where it was left off, not just the last one played.
+
+  // bt->setResumeMode(RESUME_EACH_TRACK);
 }
 
 
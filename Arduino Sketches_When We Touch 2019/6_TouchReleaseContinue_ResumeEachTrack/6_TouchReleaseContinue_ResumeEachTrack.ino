@@ -9,13 +9,15 @@
 #include <FreeStack.h> 
 #include <SFEMP3Shield.h>
 
+#if !BTUTILS_ENABLE_RESUME
+#error "This sketch needs #define BTUTILS_ENABLE_RESUME 1 in BtUtils.h"
+#endif
+
 SdFat sd;
 SFEMP3Shield MP3player;
 
 BtUtils *bt;
 
-uint32_t trackPosition[12];
-
 void setup() {
   bt = BtUtils::setup(&sd, &MP3player);
 
@@ -43,9 +45,11 @@ void setup() {
 
    bt->setTouchReleaseThreshold(10, 8);
 
-  for (int i = 0; i <= LAST_PIN; i++) {
-    trackPosition[i] = 0;
-  }
+
+  // Each track resumes from where it was left when another track was
+  // touched. A track that plays to the end starts over next time.
+
+  bt->setResumeMode(RESUME_EACH_TRACK);
 }
 
 
@@ -53,38 +57,33 @@ void loop() {
 
   int trackNumber;
   int touchStatus = bt->getPinTouchStatus(&trackNumber);
-  int lastPlayed  = bt->getLastTrackPlayed();
-  int currentLocation = bt->getCurrentTrackLocation();
   int playerStatus = bt->getPlayerStatus();
 
-  if (playerStatus == IS_STOPPED) { // Reached the end of a track?
-    bt->turnLedOff();
-    trackPosition[lastPlayed] = 0;
-    bt->stopTrack();
-  }
+  // A touch on a different track (or on this one, if it has ended) leaves
+  // the playing track, and BtUtils remembers where; the touched track
+  // resumes where it was left, or starts from the beginning if it hasn't
+  // been played yet. Touching the track that's playing changes nothing.
+
   if (touchStatus == NEW_TOUCH) {
-    if (trackNumber != lastPlayed) {
-      if (playerStatus == IS_PLAYING) {
-	trackPosition[lastPlayed] += currentLocation;
-      } else {
-	trackPosition[lastPlayed] = 0;
-      }
-      bt->startTrack(trackNumber, trackPosition[trackNumber]);
-      bt->turnLedOn();
-
-      Serial.print("Pause track ");
-      Serial.print(lastPlayed);
-      Serial.print(" at ");
-      Serial.println(trackPosition[lastPlayed]);
-      Serial.print("Start track ");
-      Serial.print(trackNumber);
-      Serial.print(" at ");
-      Serial.println(trackPosition[trackNumber]);
+    if (trackNumber != bt->getLastTrackPlayed() || playerStatus != IS_PLAYING) {
+      bt->resumeOrStartTrack(trackNumber);
     }
+    bt->turnLedOn();
   }
+
+  // Releasing the pin doesn't stop the track; it plays on until another
+  // track is touched.
+
   else if (touchStatus == NEW_RELEASE) {
     bt->turnLedOff();
   }
 
+  // Turn the LED off if the end of the track is reached while the pin is
+  // still being touched.
+
+  else if (playerStatus == IS_STOPPED) {
+    bt->turnLedOff();
+  }
+
   bt->doTimerTasks();
 }
@@ -13,13 +13,15 @@
 #include <FreeStack.h> 
 #include <SFEMP3Shield.h>
 
+#if !BTUTILS_ENABLE_RESUME
+#error "This sketch needs #define BTUTILS_ENABLE_RESUME 1 in BtUtils.h"
+#endif
+
 SdFat sd;
 SFEMP3Shield MP3player;
 
 BtUtils *bt;
 
-uint32_t trackPosition[12];
-
 void setup() {
   bt = BtUtils::setup(&sd, &MP3player);
 
@@ -46,10 +48,11 @@ void setup() {
 
   bt->setTouchReleaseThreshold(5,2);
 
-  
-  for (int i = 0; i <= LAST_PIN; i++) {
-    trackPosition[i] = 0;
-  }
+
+  // Each track resumes from where it was last paused (unless it's been
+  // longer than the idle timeout, if there is one).
+
+  bt->setResumeMode(RESUME_EACH_TRACK);
 }
 
 
@@ -58,39 +61,23 @@ void loop() {
   int trackNumber;
   int touchStatus = bt->getPinTouchStatus(&trackNumber);
 
-  // If a new touch is detected:
-  //   - if it's the same track as before, resume playing where it left off.
-  //   - if it's a different track, start it from the beginning.
+  // If a new touch is detected, resume the track where it was left off (or
+  // start it from the beginning if it hasn't been played yet).
 
-  int lastPlayed  = bt->getLastTrackPlayed();
-  int currentLocation = bt->getCurrentTrackLocation();
   int playerStatus = bt->getPlayerStatus();
   if (touchStatus == NEW_TOUCH) {
     bt->turnLedOn();
-    if (playerStatus == IS_PAUSED && trackNumber == lastPlayed) {
-      bt->resumeTrack();
-    } else {
-      if (playerStatus == IS_PLAYING) {
-        trackPosition[lastPlayed] += currentLocation;
-      } else if (playerStatus == IS_STOPPED) {
-	trackPosition[lastPlayed] = 0;
-      }
-      bt->startTrack(trackNumber, trackPosition[trackNumber]);
-    }
+    bt->resumeOrStartTrack(trackNumber);
   }
 
-  // Pause the track if a release is detected. Notice that
-  // getCurrentTrackLocation() returns the location difference from where
-  // you last started, not the absolute position, so we have to add it to
-  // the last track-position value.
+  // Pause the track if a release is detected. BtUtils remembers where each
+  // track was paused.
 
   else if (touchStatus == NEW_RELEASE) {
     bt->turnLedOff();
     if (playerStatus == IS_STOPPED) {
-      trackPosition[lastPlayed] = 0;
       bt->stopTrack();
     } else {
-      trackPosition[lastPlayed] += currentLocation;
       bt->pauseTrack();
     }
   }
@@ -49,68 +49,50 @@ void setup() {
 void loop() {
 
 
-  int highestProximity = 0;
-  int highestProximityPin = -1;
-
-
-  // Find the pin with the highest proximity reading.
-  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
-    int proximity = bt->getProximityPercent(pin);
-    if (proximity > highestProximity) {
-      highestProximity = proximity;
-      highestProximityPin = pin;
-    }
-  }
-
-  // What's currently going on? (IS_PLAYING, IS_PAUSED, or IS_STOPPED)
-  int playerStatus = bt->getPlayerStatus();
+  // Which pin is the hand over? If it's between two pins, this doesn't flip
+  // back and forth between them; another pin has to be clearly closer for
+  // a moment before it takes over (see setProximitySwitching() in the
+  // BtUtils docs). So a track only starts when the hand really moves.
+  int activePin;
+  int proximity;
+  int status = bt->getProximityPinStatus(&activePin, &proximity);
 
   // Which track was last played?
   int lastTrack = bt->getLastTrackPlayed();
 
-  // If nothing is near (proximity is zero) and a track is playing, pause it.
-  if (highestProximity == 0) {
-    if (playerStatus == IS_PLAYING) {
+  // If the hand has gone, pause the track.
+  if (status == NEW_RELEASE) {
+    if (bt->getPlayerStatus() == IS_PLAYING) {
       bt->pauseTrack();
     }
     bt->setVolume(0);
     bt->turnLedOff();
   }
 
-  // else -- proximity was detected
-  else {
-
-    // Set the volume. The proximity is in percentage 0-100, and the volume is
-    // also 0-100, so we can just set the volume to the proximity number.
-    bt->setVolume(highestProximity);
-
-    // If it's already playing but this is a different pin, switch tracks.
-    // If it's the same pin, we don't have to do anything.
-    if (playerStatus == IS_PLAYING) {
-      if (highestProximityPin != lastTrack) {
-        bt->startTrack(highestProximityPin);
-      }
-    }
-
-    else if (playerStatus == IS_PAUSED) {
-
-      // If it's paused and this is the same track, resume playing
-      if (highestProximityPin == lastTrack) {
-        bt->resumeTrack();
-      }
-
-      // If it's paused and this is a different track, switch to the new track
-      else {
-        bt->startTrack(highestProximityPin);
-      }
-
+  // If the hand came to a pin: resume the track if it's the one that was
+  // paused, otherwise start that pin's track from the beginning.
+  else if (status == NEW_TOUCH) {
+    if (activePin == lastTrack && bt->getPlayerStatus() == IS_PAUSED) {
+      bt->resumeTrack();
+    } else {
+      bt->startTrack(activePin);
     }
+    bt->turnLedOn();
+  }
 
-    // If it's currently stopped, start this track
-    else if (playerStatus == IS_STOPPED) {
-      bt->startTrack(highestProximityPin);
-    }
+  // If the track came to its end while the hand is still there, start it
+  // again from the beginning.
+  else if (activePin >= 0 && bt->getPlayerStatus() == IS_STOPPED) {
+    bt->startTrack(activePin);
+  }
 
-    bt->turnLedOn();
+  // Set the volume. The proximity is in percentage 0-100, and the volume is
+  // also 0-100, so we can just set the volume to the proximity number.
+  if (activePin >= 0) {
+    bt->setVolume(proximity);
   }
+
+  // Let BtUtils do its timed jobs, e.g. send a volume change that was
+  // held back because the last one was only a moment ago.
+  bt->doTimerTasks();
 }
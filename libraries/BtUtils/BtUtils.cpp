@@ -25,54 +25,236 @@
 
 #include "Arduino.h"
 #include "BtUtils.h"
+#include <Wire.h>
+#if BTUTILS_ENABLE_IDLE
+#include <avr/sleep.h>
+#endif
+#if BTUTILS_LOG_LEVEL >= BTUTILS_LOG_INFO
+#include <FreeStack.h>
+#endif
+#if BTUTILS_ENABLE_MIDI
+#include <SoftwareSerial.h>
+#endif
+
+// Timing statistics (see BtStats in BtUtils.h)
+#if BTUTILS_ENABLE_STATS
+#define STATS_BEGIN(start)       unsigned long start = micros()
+#define STATS_END(which, start)  BtStats::record((which), micros() - (start))
+#define STATS_TOUCHED()          BtStats::touched()
+#define STATS_PLAYING()          BtStats::playing()
+#else
+#define STATS_BEGIN(start)       do {} while (0)
+#define STATS_END(which, start)  do {} while (0)
+#define STATS_TOUCHED()          do {} while (0)
+#define STATS_PLAYING()          do {} while (0)
+#endif
 
 /*----------------------------------------------------------------------
  * Initialization.
  ----------------------------------------------------------------------*/
 
+// States of a startTrack() with a location (see _doPendingSeek())
+#define SEEK_IDLE      0	// nothing to do
+#define SEEK_WAITING   1	// track started silently, waiting to skip
+#define SEEK_ABANDONED 2	// paused before the skip; resumeTrack() starts over
+
+// How long to wait for the decoder before skipping: at least the minimum,
+// then until it knows the bit rate, but no longer than the maximum.
+#define SEEK_MIN_WAIT  100
+#define SEEK_MAX_WAIT  1000
+#define SEEK_POLL_TIME 20		// how often to ask if the decoder is ready
+
+// Timers (see doTimerTasks()); there are BTUTILS_NUM_TIMERS of them
+#define TIMER_START_DELAY  0
+#define TIMER_SEEK         1
+#define TIMER_FADE         2
+#define TIMER_VOLUME       3
+#define TIMER_RESUME_FILE  4
+#define TIMER_CALIBRATE    5
+
+// Touch sensors: sensor 0 is the TouchBoard's own MPR121, the MPR121
+// object from its library; any others get their objects here. Pin N is
+// electrode N % 12 of sensor N / 12.
+#if BTUTILS_NUM_SENSORS > 1
+static MPR121_type extraSensors[BTUTILS_NUM_SENSORS - 1];
+static const uint8_t sensorAddress[BTUTILS_MAX_SENSORS] = BTUTILS_SENSOR_ADDRESSES;
+static const uint8_t sensorIntPin[BTUTILS_MAX_SENSORS] = BTUTILS_SENSOR_INT_PINS;
+static inline MPR121_type *touchSensor(uint8_t sensor) {
+  return sensor ? &extraSensors[sensor - 1] : &MPR121;
+}
+#else
+static const uint8_t sensorAddress[1] = { MPR121_ADDR };
+static const uint8_t sensorIntPin[1] = { MPR121_INT };
+static inline MPR121_type *touchSensor(uint8_t) {
+  return &MPR121;
+}
+#endif
+#define SENSOR_OF(pin)    touchSensor((pin) / PINS_PER_SENSOR)
+#define ELECTRODE_OF(pin) ((pin) % PINS_PER_SENSOR)
+
+// Adds one sensor's touch status (from its last read) to a set of pins
+static PinSet mergeSensorTouches(PinSet touchedPins, uint8_t sensorNumber) {
+  MPR121_type *sensor = touchSensor(sensorNumber);
+  PinSet sensorPins = 0;
+  for (uint8_t i = 0; i < PINS_PER_SENSOR; i++) {
+    if (sensor->getTouchData(i))
+      sensorPins |= PIN_BIT(i);
+  }
+  uint8_t shift = sensorNumber * PINS_PER_SENSOR;
+  touchedPins &= ~((PIN_BIT(PINS_PER_SENSOR) - 1) << shift);
+  return touchedPins | (sensorPins << shift);
+}
+
+#if BTUTILS_ENABLE_IDLE
+// Is any sensor's IRQ line low, i.e. has it got a touch or release to read?
+static bool touchSensorsChanged() {
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    if (touchSensor(s)->touchStatusChanged())
+      return true;
+  }
+  return false;
+}
+#endif
+
+#define FADE_STEP_TIME 10		// milliseconds between fade steps
+
+// Proximity readings (baseline minus reading) from LOW_DIFF to HIGH_DIFF
+// map to 0 to 100 percent. Auto-calibration moves each pin's range up
+// above its noise.
+#define LOW_DIFF 0
+#define HIGH_DIFF 50
+
 BtUtils::BtUtils(SdFat *sd_in, SFEMP3Shield *MP3player_in) {
 
-  // Note: this can't be created as a static object. See comments below
-  // in setup().
+  // Note: this can't be created as a static object at the program start.
+  // See comments below in setup().
+
+  _timerCount          = 0;
+#if BTUTILS_ENABLE_IDLE
+  _idleSince           = 0;
+  _touchSampleSlow     = false;
+  _timeAsleep          = 0;
+#endif
 
   _playerStatus        = IS_STOPPED;
   _lastTrackPlayed     = -1;
   _lastStartTime       = 0;
   _lastStopTime        = 0;
+#if BTUTILS_ENABLE_START_AFTER_DELAY
   _startDelay          = 1000;
+#endif
   _lastActionTime      = 0;
   _startOverIfIdleTime = -1;
 
-  _targetVolume        = 100;
-  _actualVolume        = 100;
+  _targetVolumeLeft    = 100;
+  _targetVolumeRight   = 100;
+  _actualVolumeLeft    = 100;
+  _actualVolumeRight   = 100;
+  _volumeByteLeft      = 0xFF;	// not a real volume: forces the first write
+  _volumeByteRight     = 0xFF;
+  _volumeWriteInterval = 10;
+  _lastVolumeWriteTime = 0;
+  _volumeWritePending  = false;
+#if BTUTILS_ENABLE_FADES
   _fadeInTime          = 0;
   _fadeOutTime         = 0;
-  _thisFadeInTime      = 0;
-  _thisFadeOutTime     = 0;
+  _switchFadeTime      = 0;
+  _fade.active         = false;
+  _fadeCurve           = FADE_CURVE_LINEAR;
+  _switchTrack         = -1;
+  _switchLocation      = 0;
+#endif
+
+  _seekState          = SEEK_IDLE;
+  _seekLocation       = 0;
+  _seekStartTime      = 0;
+
+#if BTUTILS_ENABLE_RESUME
+  _resumeMode         = RESUME_SINGLE;
+  _resumeFileInterval = 0;
+  _resumeFileSaveTime = 0;
+  _resumeFileDirty    = false;
+  forgetSavedTrackLocations();
+#endif
 
   _lastPinTouched = -1;
+  _touchedPins    = 0;
+  _newTouches     = 0;
+  _newReleases    = 0;
+  _unreportedTouches  = 0;
+  _unreportedReleases = 0;
+  _touchStateTime = 0;
+  _touchStateUnseen = false;
+
+#if BTUTILS_ENABLE_TOUCH_EVENTS
+  _touchQueueHead = 0;
+  _touchQueueTail = 0;
+  _touchEventPins = 0;
+#endif
+
+#if BTUTILS_ENABLE_MIDI
+  _midiMode     = false;
+  _midiNotesOn  = 0;
+#if BTUTILS_ENABLE_PROXIMITY
+  _midiVelocity = 0;
+#else
+  _midiVelocity = BTUTILS_MIDI_VELOCITY;
+#endif
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
+    _midiNote[pin]    = 60 + pin;	// middle C and up
+    _midiChannel[pin] = 0;
+  }
+#endif
 
-  _lastProximity       = 0.0;
-  _proximityMultiplier = 1.3;
+  _touchThreshold   = 40;	// as set in setup()
+  _releaseThreshold = 20;
+#if BTUTILS_ENABLE_CALIBRATION
+  memset(_pinNoise, 0, sizeof(_pinNoise));
+  _calibrationSamples  = 0;
+  _calibrated          = false;
+  _recalibrateInterval = 0;
+#endif
+
+#if BTUTILS_ENABLE_PROXIMITY
+  _proximityMultiplier = 333;	// 1.3
+  setProximityFilter(PROXIMITY_FILTER_IIR, 30);
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
+    _proximityFilter[pin].low = LOW_DIFF;
+    _proximity[pin] = 0;
+  }
+  _sensorDataTime = millis() - BTUTILS_SENSOR_READ_INTERVAL;	// none yet
+  _proximityPin        = -1;
+  _proximityChallenger = -1;
+  _challengerSince     = 0;
+  setProximitySwitching(10, 100);
+#endif
 
   _sd = sd_in;
   _MP3player = MP3player_in;
 
-  setVolume(100);
+#if BTUTILS_ENABLE_TRACK_CATALOG
+  memset(_trackCatalog, 0, sizeof(_trackCatalog));
+  _catalogBuilt = false;
+#endif
+
+  _setActualVolume(100, 100, true);
 }
 
 BtUtils* BtUtils::setup(SdFat *sd, SFEMP3Shield *MP3player) {
 
   // Note: it might seem like this could be a static object declared at the
   // program start, but that doesn't work due to some out-of-sequence
-  // operations that would occur before the BareTouch board is ready. By
-  // creating the BtUtils object dynamically during the Arduino setup()
-  // function, we avoid those problems.
+  // operations that would occur before the BareTouch board is ready. The
+  // BtUtils object is a static variable inside this function instead: it
+  // takes no heap memory (so malloc() isn't needed at all, and the free
+  // RAM is the same every time), but it isn't constructed until the first
+  // time this runs, during the Arduino setup() function, after everything
+  // below is ready.
 
   pinMode(LED_BUILTIN, OUTPUT);
 
-  unsigned long start_millis = millis();
   Serial.begin(57600);
+//   unsigned long start_millis = millis();
 //   while (!Serial && ((millis() - start_millis) < 2000)) ; {}
 //   delay(250);		// bug: without this delay and println('-----'), won't print the "Setup" message
 //   Serial.println("-------");
@@ -81,32 +263,217 @@ BtUtils* BtUtils::setup(SdFat *sd, SFEMP3Shield *MP3player) {
   if (!sd->begin(SD_SEL, SPI_HALF_SPEED))
     sd->initErrorHalt();
 
-  if (!MPR121.begin(MPR121_ADDR))
-    SERIAL_PRINTLN("error setting up MPR121");
-  MPR121.setInterruptPin(MPR121_INT);
-  MPR121.setTouchThreshold(40);
-  MPR121.setReleaseThreshold(20);
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    MPR121_type *sensor = touchSensor(s);
+    if (!sensor->begin(sensorAddress[s]))
+      LOG_ERROR("error setting up MPR121 at address ", sensorAddress[s]);
+    sensor->setInterruptPin(sensorIntPin[s]);
+    sensor->setTouchThreshold(40);
+    sensor->setReleaseThreshold(20);
+  }
+  Wire.setClock(BTUTILS_I2C_CLOCK);
+  // On the Touch Board the MPR121's IRQ line is on a pin that can't raise
+  // an interrupt, in which case _readTouchState() just reads the line.
+  if (digitalPinToInterrupt(MPR121_INT) != NOT_AN_INTERRUPT)
+    attachInterrupt(digitalPinToInterrupt(MPR121_INT), _touchIrq, FALLING);
 
   byte result = MP3player->begin();
  
   if(result != 0) {
-    SERIAL_PRINT("Error code: ");
-    SERIAL_PRINT(result);
-    SERIAL_PRINTLN(" when trying to start MP3 player");
-   }
+    LOG_ERROR("error starting MP3 player, code ", result);
+  }
+
+  static BtUtils bt(sd, MP3player);
+#if BTUTILS_ENABLE_TRACK_CATALOG
+  bt._buildTrackCatalog();
+#endif
+  LOG_INFO("setup done, free RAM: ", FreeStack());
+  return &bt;
+}
+
+/*----------------------------------------------------------------------
+ * Logging. Messages are queued by the LOG_xxx() macros and printed later
+ * by drain(), which is called from doTimerTasks(). Nothing here ever waits
+ * for the Serial port.
+ ----------------------------------------------------------------------*/
+
+#if BTUTILS_LOG_LEVEL > BTUTILS_LOG_NONE
+
+BtLog::Entry BtLog::_queue[BTUTILS_LOG_QUEUE_SIZE];
+uint8_t BtLog::_head = 0;
+uint8_t BtLog::_tail = 0;
+unsigned int BtLog::_dropped = 0;
+unsigned int BtLog::_droppedTotal = 0;
+
+void BtLog::_put(const char *msg, int value, bool inFlash) {
+  uint8_t next = (_head + 1) & (BTUTILS_LOG_QUEUE_SIZE - 1);
+  if (next == _tail) {		// full: drop the new message, but count it
+    if (_dropped < 0xFFFF)
+      _dropped++;
+    if (_droppedTotal < 0xFFFF)
+      _droppedTotal++;
+    return;
+  }
+  _queue[_head].msg = msg;
+  _queue[_head].value = value;
+  _queue[_head].inFlash = inFlash;
+  _head = next;
+}
+
+void BtLog::log(const __FlashStringHelper *msg, int value) {
+  _put((const char *)msg, value, true);
+}
+
+void BtLog::log(const char *msg, int value) {
+  _put(msg, value, false);
+}
+
+unsigned int BtLog::getDroppedCount() {
+  return _droppedTotal;
+}
+
+void BtLog::drain() {
+
+  // Print messages only while the whole line (message, up to six digits
+  // of value, and CR/LF) fits in the Serial transmit buffer, so that
+  // print() never has to wait. (An unusually long message only waits for
+  // room for its first 48 characters, or it would never get printed.)
+
+  while (_tail != _head) {
+    Entry *e = &_queue[_tail];
+    int len = (e->inFlash ? strlen_P(e->msg) : strlen(e->msg)) + 8;
+    if (len > 48)
+      len = 48;
+    if (Serial.availableForWrite() < len)
+      return;
+    if (e->inFlash)
+      Serial.print((const __FlashStringHelper *)e->msg);
+    else
+      Serial.print(e->msg);
+    Serial.println(e->value);
+    _tail = (_tail + 1) & (BTUTILS_LOG_QUEUE_SIZE - 1);
+  }
+
+  if (_dropped > 0 && Serial.availableForWrite() >= 32) {
+    Serial.print(F("log: messages dropped: "));
+    Serial.println(_dropped);
+    _dropped = 0;
+  }
+}
+
+#endif
+
+/*----------------------------------------------------------------------
+ * Timing statistics. Each kind of timing keeps a total, a count and the
+ * longest; the loop also keeps the shortest, and a histogram. Once the
+ * count or the total is full, both stop, so the average stays right.
+ ----------------------------------------------------------------------*/
 
-  BtUtils* bt = new BtUtils(sd, MP3player);
-  return bt;
+#if BTUTILS_ENABLE_STATS
+
+BtStats::Timing BtStats::_timing[STAT_COUNT];
+BtStats::Timing BtStats::_loop;
+unsigned long BtStats::_loopStart = 0;
+unsigned long BtStats::_loopMin = 0xFFFFFFFF;
+unsigned int BtStats::_loopHistogram[BTUTILS_STATS_BUCKETS];
+unsigned long BtStats::_touchTime = 0;
+
+void BtStats::_add(Timing *t, unsigned long micros) {
+  if (micros > t->max)
+    t->max = micros;
+  if (t->count == 0xFFFF || t->total > 0xFFFFFFFF - micros)
+    return;
+  t->total += micros;
+  t->count++;
+}
+
+void BtStats::record(uint8_t which, unsigned long micros) {
+  _add(&_timing[which], micros);
+}
+
+void BtStats::loop() {
+  unsigned long now = micros();
+  if (_loopStart != 0) {
+    unsigned long period = now - _loopStart;
+    _add(&_loop, period);
+    if (period < _loopMin)
+      _loopMin = period;
+    uint8_t bucket = 0;
+    for (unsigned long ms = period >> 10; ms > 0 && bucket < BTUTILS_STATS_BUCKETS - 1; ms >>= 1)
+      bucket++;
+    if (_loopHistogram[bucket] < 0xFFFF)
+      _loopHistogram[bucket]++;
+  }
+  _loopStart = now;
+}
+
+void BtStats::touched() {
+  _touchTime = micros() | 1;	// zero means no touch waiting
+}
+
+void BtStats::playing() {
+  if (_touchTime == 0)
+    return;
+  record(STAT_TOUCH_TO_PLAY, micros() - _touchTime);
+  _touchTime = 0;
+}
+
+void BtStats::reset() {
+  memset(_timing, 0, sizeof(_timing));
+  memset(&_loop, 0, sizeof(_loop));
+  memset(_loopHistogram, 0, sizeof(_loopHistogram));
+  _loopMin = 0xFFFFFFFF;
+  _loopStart = 0;
+  _touchTime = 0;
+}
+
+void BtStats::_printTiming(const __FlashStringHelper *name, Timing *t) {
+  if (name) {
+    Serial.print(name);
+    Serial.print(F(" us: "));
+  }
+  Serial.print(F("avg "));
+  Serial.print(t->count ? t->total / t->count : 0);
+  Serial.print(F(" max "));
+  Serial.print(t->max);
+  Serial.print(F(" n "));
+  Serial.println(t->count);
 }
 
+void BtStats::print() {
+
+  // This prints a lot, and waits for the Serial port to do it; it's meant
+  // to be called once in a while (e.g. when a pin is held down), not
+  // every time through the loop.
+
+  Serial.print(F("loop us: min "));
+  Serial.print(_loopMin == 0xFFFFFFFF ? 0 : _loopMin);
+  Serial.print(' ');
+  _printTiming(NULL, &_loop);
+  Serial.print(F("loop ms histogram (<1 <2 <4 ...):"));
+  for (uint8_t i = 0; i < BTUTILS_STATS_BUCKETS; i++) {
+    Serial.print(' ');
+    Serial.print(_loopHistogram[i]);
+  }
+  Serial.println();
+  _printTiming(F("touch scan"), &_timing[STAT_TOUCH_SCAN]);
+  _printTiming(F("proximity scan"), &_timing[STAT_PROXIMITY_SCAN]);
+  _printTiming(F("fade step"), &_timing[STAT_FADE]);
+  _printTiming(F("MP3 player"), &_timing[STAT_PLAYER]);
+  _printTiming(F("SD card"), &_timing[STAT_SD_CARD]);
+  _printTiming(F("touch to play"), &_timing[STAT_TOUCH_TO_PLAY]);
+  _printTiming(F("track start"), &_timing[STAT_TRACK_START]);
+}
+
+#endif
+
 /*----------------------------------------------------------------------
  * Simple utility functions
  ----------------------------------------------------------------------*/
 
-#ifdef DEBUG
+#if BTUTILS_LOG_LEVEL > BTUTILS_LOG_NONE
 void BtUtils::_log_action(const char *msg, int track) {
-  Serial.print(msg);
-  Serial.println(track);
+  BtLog::log(msg, track);
 }
 #endif
 
@@ -133,109 +500,372 @@ void BtUtils::setTouchReleaseThreshold(int touchThreshold, int releaseThreshold)
   if (releaseThreshold < 0)
     releaseThreshold = 0;
 
-  MPR121.setTouchThreshold(touchThreshold);
-  MPR121.setReleaseThreshold(releaseThreshold);
-  LOG_ACTION("Touch threshold: ", touchThreshold);
-  LOG_ACTION("Release threshold: ", releaseThreshold);
-}  
+  _touchThreshold = touchThreshold;
+  _releaseThreshold = releaseThreshold;
+  LOG_INFO("Touch threshold: ", touchThreshold);
+  LOG_INFO("Release threshold: ", releaseThreshold);
+#if BTUTILS_ENABLE_CALIBRATION
+  if (_calibrated) {
+    _applyCalibration();	// noisy pins keep their higher thresholds
+    return;
+  }
+#endif
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    touchSensor(s)->setTouchThreshold(touchThreshold);
+    touchSensor(s)->setReleaseThreshold(releaseThreshold);
+  }
+}
 
-int BtUtils::getPinTouchStatus(int *whichPinChanged) {
+#if BTUTILS_ENABLE_CALIBRATION
 
-  *whichPinChanged = -1;
-  bool pinIsTouched[NUM_PINS];
+/*----------------------------------------------------------------------
+ * Auto-calibration. The MPR121 can work out the best charge current and
+ * time for each electrode by itself (its "auto-configuration"), which
+ * takes care of different electrode sizes and cable lengths. What it
+ * can't do is tell how noisy each electrode is, so that's measured here,
+ * and each pin's touch threshold is raised above its noise.
+ ----------------------------------------------------------------------*/
 
-  if (!MPR121.touchStatusChanged())
-    return TOUCH_NO_CHANGE;
+#define CALIBRATE_SAMPLES      16	// readings per measurement
+#define CALIBRATE_SAMPLE_TIME  10	// milliseconds between readings
+#define CALIBRATE_RETRY_TIME   10000	// busy: measure again this much later
+#define CALIBRATE_NOISE_MARGIN 3	// touch threshold: at least noise times this
+
+// MPR121 auto-configuration limits for a 3.3 V supply (from the data
+// sheet): USL = (Vdd - 0.7) / Vdd * 256, TL = 90% and LSL = 65% of USL.
+#define AUTOCONFIG_USL 201
+#define AUTOCONFIG_TL  181
+#define AUTOCONFIG_LSL 131
+
+void BtUtils::autoCalibrate(int recalibrateMinutes) {
+
+  // Call this in setup() with nothing near the electrodes; it takes a
+  // fraction of a second. If recalibrateMinutes is more than zero, the
+  // noise is measured again that often (a little at a time, from
+  // doTimerTasks(), and only while no pin is touched), to follow changes
+  // in humidity and so on.
+
+  // The auto-configuration's filter and baseline settings have to match
+  // the ones the MPR121 is using. Writing ACCR0 restarts the MPR121, which
+  // runs the auto-configuration.
+
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    MPR121_type *sensor = touchSensor(s);
+    uint8_t firstFilterIterations = sensor->getRegister(MPR121_AFE1) & 0xC0;
+    uint8_t baselineTracking = sensor->getRegister(MPR121_ECR) & 0xC0;
+    sensor->setRegister(MPR121_USL, AUTOCONFIG_USL);
+    sensor->setRegister(MPR121_TL, AUTOCONFIG_TL);
+    sensor->setRegister(MPR121_LSL, AUTOCONFIG_LSL);
+    sensor->setRegister(MPR121_ACCR1, 0x00);
+    sensor->setRegister(MPR121_ACCR0, firstFilterIterations | (baselineTracking >> 4) | 0x03);
+    LOG_INFO("MPR121 auto-configuration, sensor ", s);
+  }
 
-  MPR121.updateTouchData();
-
-  // Loop over pins, find the status of each. Note that it seems to be
-  // necessary to check every pin every time anyway so that isNewTouch()
-  // returns correctly the next time we try.
-  // Serial.print("_lastPinTouched: ");
-  // Serial.print(_lastPinTouched);
-  // Serial.print(", ");
-  Serial.print("pins: ");
-  unsigned char numPinsTouched = 0;
-  for (unsigned char i = FIRST_PIN; i <= LAST_PIN; i++) {
-    pinIsTouched[i] = MPR121.getTouchData(i);
-    if (pinIsTouched[i]) {
-      Serial.print(i);
-      numPinsTouched++;
-    } else {
-      Serial.print((i > 9) ? "  " : " ");
-    }
-    Serial.print(" ");
-  }
-  
-  // If last status says no pin was touched
-  //   if no pins are touched now
-  //     - status is TOUCH_NO_CHANGE
-  //   else
-  //     - status is NEW_TOUCH
-  //     - *whichPin is lowest-numbered pin 
-  // else (last status says a pin was being touched)
-  //   if the last pin touched is still touched
-  //     - status is TOUCH_NO_CHANGE
-  //   else (the last pin touched isn't any more)
-  //     - If no other pins are touched
-  //          - status NEW_RELEASE on that pin
-  //          - lastPinTouched is -1
-  //     - else (another pin is being touched)
-  //        - status is NEW_TOUCH on that pin
-  //        - lastPinTouched is that pin
-  //
-  // record new pin state
-  // return status and *whichPinChanged
+  _recalibrateInterval = (recalibrateMinutes > 0) ? recalibrateMinutes * 60000UL : 0;
+  _startCalibration();
+  while (!_takeCalibrationSample())
+    delay(CALIBRATE_SAMPLE_TIME);
+}
 
-  int touchStatus;
-  if (_lastPinTouched < 0) {	// Last time through, no pin was touched, so this is new
-    if (numPinsTouched == 0) {
-      touchStatus = TOUCH_NO_CHANGE;
-    }
-    else {
-      touchStatus = NEW_TOUCH;
-      for (unsigned char i = FIRST_PIN; i <= LAST_PIN; i++) {
-	if (pinIsTouched[i]) {
-	  *whichPinChanged = i;
-	  break;
-	}
-      }
-    }
-  } else {  // Last time through, a pin was touched, so check for changes
-    if (pinIsTouched[_lastPinTouched]) {	// Same pin stil being touched?
-      touchStatus = TOUCH_NO_CHANGE;
-    } else {					// Last pin touched has been released
-      if (numPinsTouched == 0) {
-	touchStatus = NEW_RELEASE;
-	*whichPinChanged = _lastPinTouched;
-      } else {
-	touchStatus = NEW_TOUCH;
-	for (unsigned char i = FIRST_PIN; i <= LAST_PIN; i++) {
-	  if (pinIsTouched[i]) {
-	    *whichPinChanged = i;
-	    break;
-	  }
-	}
-      }
+void BtUtils::_startCalibration() {
+  memset(_pinNoise, 0, sizeof(_pinNoise));
+  _calibrationSamples = 0;
+}
+
+bool BtUtils::_takeCalibrationSample() {
+
+  // One reading of every pin; returns true when the measurement is done
+  // and the thresholds have been set. Only the baseline and filtered data
+  // are read, so a touch status change is left for _readTouchState().
+
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    touchSensor(s)->updateBaselineData();
+    touchSensor(s)->updateFilteredData();
+  }
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
+    MPR121_type *sensor = SENSOR_OF(pin);
+    int delta = abs(sensor->getBaselineData(ELECTRODE_OF(pin)) - sensor->getFilteredData(ELECTRODE_OF(pin)));
+    if (delta > 255)
+      delta = 255;
+    if (delta > _pinNoise[pin])
+      _pinNoise[pin] = delta;
+  }
+  if (++_calibrationSamples < CALIBRATE_SAMPLES)
+    return false;
+  _calibrationSamples = 0;	// the next measurement starts afresh
+  _applyCalibration();
+  _calibrated = true;
+  if (_recalibrateInterval > 0)
+    _setTimer(TIMER_CALIBRATE, millis() + _recalibrateInterval);
+  return true;
+}
+
+void BtUtils::_applyCalibration() {
+
+  // Each pin gets the thresholds from setTouchReleaseThreshold(), unless
+  // it's too noisy for them; then both are raised, keeping their ratio.
+  // Proximity readings below a pin's noise count as nothing.
+
+  // Every threshold write stops and restarts the MPR121, so only the ones
+  // that change are written; reading one back doesn't restart anything.
+
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
+    int touch = _touchThreshold;
+    int release = _releaseThreshold;
+    int quiet = _pinNoise[pin] * CALIBRATE_NOISE_MARGIN;
+    if (quiet > touch) {
+      if (quiet > 255)
+	quiet = 255;
+      release = (int)(((long)release * quiet) / touch);
+      touch = quiet;
     }
+    MPR121_type *sensor = SENSOR_OF(pin);
+    if (sensor->getTouchThreshold(ELECTRODE_OF(pin)) != touch)
+      sensor->setTouchThreshold(ELECTRODE_OF(pin), touch);
+    if (sensor->getReleaseThreshold(ELECTRODE_OF(pin)) != release)
+      sensor->setReleaseThreshold(ELECTRODE_OF(pin), release);
+#if BTUTILS_ENABLE_PROXIMITY
+    _proximityFilter[pin].low = min(_pinNoise[pin], (uint8_t)(HIGH_DIFF - LOW_DIFF));
+#endif
+    LOG_DEBUG("calibrated touch threshold: ", touch);
   }
+  LOG_INFO("calibrated, noise on pin 0: ", _pinNoise[0]);
+}
+
+void BtUtils::_recalibrate() {
+
+  // Called by the timer: one reading per call, CALIBRATE_SAMPLE_TIME
+  // apart. A touch spoils the measurement, so it starts over later. The
+  // touch itself is still reported: getPinTouchStatus() and the others
+  // compare against what they last reported, not against this read.
+
+  _readTouchState();
+  if (_touchedPins != 0) {
+    _calibrationSamples = 0;
+    _setTimer(TIMER_CALIBRATE, millis() + CALIBRATE_RETRY_TIME);
+    return;
+  }
+  if (_calibrationSamples == 0)
+    memset(_pinNoise, 0, sizeof(_pinNoise));
+  if (!_takeCalibrationSample())
+    _setTimer(TIMER_CALIBRATE, millis() + CALIBRATE_SAMPLE_TIME);
+}
+
+#endif
+
+volatile bool BtUtils::_touchIrqPending = false;
+
+void BtUtils::_touchIrq() {
+  _touchIrqPending = true;	// the I2C read happens later, in _readTouchState()
+}
+
+bool BtUtils::_readTouchState() {
 
-  if (touchStatus == NEW_TOUCH) {
+  // Each MPR121 pulls its IRQ line low when any of its pins' touch status
+  // changes, so a sensor whose line is high has nothing to read over I2C.
+
+  // A proximity read also reads the touch status, which resets the IRQ
+  // line, so what it found is picked up here too.
+
+  bool irq = _touchIrqPending;
+  _touchIrqPending = false;
+  bool changed = _touchStateUnseen;
+  _touchStateUnseen = false;
+  PinSet touchedPins = _touchedPins;
+  bool read = false;
+
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    MPR121_type *sensor = touchSensor(s);
+    if (!(irq && s == 0) && !sensor->touchStatusChanged())
+      continue;
+
+    // One I2C read gets the status of all of a sensor's pins;
+    // getTouchData() just picks bits out of what was read.
+
+    STATS_BEGIN(start);
+    sensor->updateTouchData();
+    STATS_END(STAT_TOUCH_SCAN, start);
+    touchedPins = mergeSensorTouches(touchedPins, s);
+    read = true;
+  }
+  if (read) {
+    _setTouchedPins(touchedPins);
+    changed = true;
+  }
+  return changed;
+}
+
+void BtUtils::_setTouchedPins(PinSet touchedPins) {
+  _touchStateTime = millis();
+  if (touchedPins & ~_touchedPins)
+    STATS_TOUCHED();
+  _unreportedTouches  |= touchedPins & ~_touchedPins;
+  _unreportedReleases |= _touchedPins & ~touchedPins;
+  _touchedPins = touchedPins;
+  LOG_DEBUG("touched pins (bitmask): ", touchedPins);
+#if BTUTILS_ENABLE_TOUCH_EVENTS
+  _queueTouchEvents();
+#endif
+}
+
+bool BtUtils::updateTouchState() {
+
+  // Changes found by any read since the last call count, not just this
+  // one's, so a touch picked up by a recalibration isn't lost.
+
+  _readTouchState();
+  _newTouches = _unreportedTouches;
+  _newReleases = _unreportedReleases;
+  _unreportedTouches = 0;
+  _unreportedReleases = 0;
+  return (_newTouches | _newReleases) != 0;
+}
+
+PinSet BtUtils::getTouchedPins() {
+  return _touchedPins;
+}
+
+PinSet BtUtils::getNewTouches() {
+  return _newTouches;
+}
+
+PinSet BtUtils::getNewReleases() {
+  return _newReleases;
+}
+
+bool BtUtils::isPinTouched(int pinNumber) {
+  if (pinNumber < FIRST_PIN || pinNumber > LAST_PIN)
+    return false;
+  return (_touchedPins & PIN_BIT(pinNumber)) != 0;
+}
+
+// Removes the lowest-numbered pin from a set of pins, and returns it (or -1
+// if the set is empty). Handy for going through the pins in a mask:
+//
+//   PinSet pins = bt->getNewTouches();
+//   int pin;
+//   while ((pin = BtUtils::takeLowestPin(&pins)) >= 0) { ... }
+
+int BtUtils::takeLowestPin(PinSet *pinSet) {
+  if (*pinSet == 0)
+    return -1;
+#if NUM_PINS <= 16
+  int pin = __builtin_ctz(*pinSet);
+#elif NUM_PINS <= 32
+  int pin = __builtin_ctzl(*pinSet);
+#else
+  int pin = __builtin_ctzll(*pinSet);
+#endif
+  *pinSet &= *pinSet - 1;	// clear the lowest bit
+  return pin;
+}
+
+int BtUtils::getPinTouchStatus(int *whichPinChanged) {
+
+  // The original single-pin interface, on top of the multi-touch state.
+
+  *whichPinChanged = -1;
+
+  // The state may have been read since the last call (by a proximity
+  // read, a recalibration or updateTouchState()), so the pins are always
+  // compared with the last pin reported, not only when this read finds
+  // something new.
+
+  _readTouchState();
+
+  // If the last pin touched is still touched
+  //   - status is TOUCH_NO_CHANGE
+  // else if any pins are touched now
+  //   - status is NEW_TOUCH
+  //   - *whichPin is lowest-numbered pin
+  //   - lastPinTouched is that pin
+  // else if a pin was touched last time
+  //   - status NEW_RELEASE on that pin
+  //   - lastPinTouched is -1
+  // else
+  //   - status is TOUCH_NO_CHANGE
+
+  int touchStatus = TOUCH_NO_CHANGE;
+  if (_lastPinTouched >= 0 && (_touchedPins & PIN_BIT(_lastPinTouched))) {
+    touchStatus = TOUCH_NO_CHANGE;
+  } else if (_touchedPins != 0) {
+    PinSet pins = _touchedPins;
+    touchStatus = NEW_TOUCH;
+    *whichPinChanged = takeLowestPin(&pins);
     _lastPinTouched = *whichPinChanged;
-  } else if (touchStatus == NEW_RELEASE) {
+    LOG_DEBUG("touch ", *whichPinChanged);
+  } else if (_lastPinTouched >= 0) {
+    touchStatus = NEW_RELEASE;
+    *whichPinChanged = _lastPinTouched;
     _lastPinTouched = -1;
+    LOG_DEBUG("release ", *whichPinChanged);
   }
-  
-  Serial.print((touchStatus == TOUCH_NO_CHANGE ? "No Change " : (touchStatus == NEW_TOUCH ? "Touch " : "Release ")));
-  if (*whichPinChanged >= 0) {
-    Serial.print(*whichPinChanged);
-  }
-  Serial.println("");
 
   return touchStatus;
 }
 
+#if BTUTILS_ENABLE_TOUCH_EVENTS
+
+void BtUtils::_queueTouchEvents() {
+
+  // Called by every read that changes the touch state, whoever asked for
+  // it (getPinTouchStatus(), a proximity scan, a recalibration, ...), so
+  // a quick tap whose touch and release are both read between two calls
+  // of pollTouchEvent() still gets both its events.
+
+  // Queue one event for every pin whose state differs from what the
+  // queue last reported, in pin order. If the queue fills up, the rest
+  // stay different and are queued on a later call.
+
+  PinSet changedPins = _touchedPins ^ _touchEventPins;
+  int pin;
+  while ((pin = takeLowestPin(&changedPins)) >= 0) {
+    uint8_t next = (_touchQueueHead + 1) & (BTUTILS_TOUCH_QUEUE_SIZE - 1);
+    if (next == _touchQueueTail) {
+      LOG_DEBUG("touch queue full, deferred pin ", pin);
+      break;
+    }
+    PinSet bit = PIN_BIT(pin);
+    TouchEvent *e = &_touchQueue[_touchQueueHead];
+    e->pin = pin;
+    e->status = (_touchedPins & bit) ? NEW_TOUCH : NEW_RELEASE;
+    e->time = _touchStateTime;
+    _touchQueueHead = next;
+    _touchEventPins ^= bit;
+  }
+}
+
+int BtUtils::pollTouchEvent(int *whichPinChanged, unsigned long *eventTime) {
+
+  // Returns the oldest touch or release that hasn't been returned yet, so
+  // touches that come faster than the loop aren't lost, and simultaneous
+  // touches on several pins are all reported, one per call.
+
+  _readTouchState();
+  _queueTouchEvents();		// whatever a full queue held back
+
+  if (_touchQueueTail == _touchQueueHead) {
+    *whichPinChanged = -1;
+    return TOUCH_NO_CHANGE;
+  }
+  TouchEvent *e = &_touchQueue[_touchQueueTail];
+  *whichPinChanged = e->pin;
+  if (eventTime)
+    *eventTime = e->time;
+  int status = e->status;
+  _touchQueueTail = (_touchQueueTail + 1) & (BTUTILS_TOUCH_QUEUE_SIZE - 1);
+  if (status == NEW_TOUCH) {
+    LOG_DEBUG("touch event ", *whichPinChanged);
+  } else {
+    LOG_DEBUG("release event ", *whichPinChanged);
+  }
+  return status;
+}
+
+#endif
+
+#if BTUTILS_ENABLE_PROXIMITY
+
 /*----------------------------------------------------------------------
  * Proximity sensor.
  ----------------------------------------------------------------------*/
@@ -247,74 +877,552 @@ void BtUtils::setProximitySensingMode() {
   // filtering out slow hand movements. There is no explanation of these in
   // the example, so they're just copied here verbatim.
 
-  MPR121.setRegister(MPR121_NHDF, 0x01); // noise half delta (falling)
-  MPR121.setRegister(MPR121_FDLF, 0x3F); // filter delay limit (falling)   
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    touchSensor(s)->setRegister(MPR121_NHDF, 0x01); // noise half delta (falling)
+    touchSensor(s)->setRegister(MPR121_FDLF, 0x3F); // filter delay limit (falling)
+  }
+}
+
+
+void BtUtils::setProximityFilter(int filterType, int strength, int pinNumber) {
+
+  // filterType is one of the PROXIMITY_FILTER_xxx values. strength is 0 to
+  // 100: how much smoothing the IIR filter does, or how much the adaptive
+  // filter does when the hand is holding still (it smooths less as the
+  // hand moves faster). The median filter ignores strength.
+
+  if (strength < 0)
+    strength = 0;
+  if (strength > 99)
+    strength = 99;
+  uint8_t weight = (uint8_t)((strength * 256L) / 100);
+
+  int first = FIRST_PIN;
+  int last = LAST_PIN;
+  if (pinNumber != ALL_PINS) {
+    if (pinNumber < FIRST_PIN || pinNumber > LAST_PIN)
+      return;
+    first = last = pinNumber;
+  }
+  for (int pin = first; pin <= last; pin++) {
+    ProximityFilter *f = &_proximityFilter[pin];
+    f->type = filterType;
+    f->weight = weight;
+    f->value = 0;
+    f->speed = 0;
+    memset(f->history, 0, sizeof(f->history));
+    f->historyPos = 0;
+  }
+  LOG_INFO("proximity filter: ", filterType);
+}
+
+int16_t BtUtils::_filterProximity(ProximityFilter *f, uint8_t reading) {
+
+  int16_t x = (int16_t)reading << 8;
+
+  switch (f->type) {
+
+  case PROXIMITY_FILTER_IIR:
+    // Simple low-pass: move part way from the last value to the new one
+    f->value += (int16_t)(((int32_t)(x - f->value) * (256 - f->weight)) >> 8);
+    break;
+
+  case PROXIMITY_FILTER_MEDIAN: {
+    // Middle of the last few readings: ignores single-sample spikes
+    // without slowing down real changes as much as the IIR filter does.
+    f->history[f->historyPos] = reading;
+    if (++f->historyPos >= BTUTILS_PROXIMITY_MEDIAN_SIZE)
+      f->historyPos = 0;
+    uint8_t sorted[BTUTILS_PROXIMITY_MEDIAN_SIZE];
+    memcpy(sorted, f->history, sizeof(sorted));
+    for (uint8_t i = 1; i < BTUTILS_PROXIMITY_MEDIAN_SIZE; i++) {
+      uint8_t v = sorted[i];
+      uint8_t j = i;
+      for ( ; j > 0 && sorted[j-1] > v; j--)
+	sorted[j] = sorted[j-1];
+      sorted[j] = v;
+    }
+    f->value = (int16_t)sorted[BTUTILS_PROXIMITY_MEDIAN_SIZE/2] << 8;
+    break;
+  }
+
+  case PROXIMITY_FILTER_ADAPTIVE: {
+    // Like the IIR filter, but the faster the reading is changing the less
+    // it smooths (the idea behind the "one euro" filter): steady when the
+    // hand is still, yet quick to follow when it moves.
+    int16_t change = x - f->value;
+    int16_t size = (change < 0) ? -change : change;
+    f->speed += (size - f->speed) >> 2;
+    uint16_t follow = (256 - f->weight) + (f->speed >> 3);
+    if (follow > 256)
+      follow = 256;
+    f->value += (int16_t)(((int32_t)change * follow) >> 8);
+    break;
+  }
+
+  default:
+    f->value = x;
+    break;
+  }
+  return f->value;
+}
+
+void BtUtils::_readSensorData() {
+
+  // Reads all the MPR121s' data, unless that was done less than
+  // BTUTILS_SENSOR_READ_INTERVAL ago: the MPR121 has nothing new sooner
+  // than that, and every read holds up the loop (and the MP3 player's
+  // next refill) for the whole I2C transfer. Every pin's proximity goes
+  // through its filter once per read, so the filters work the same
+  // however fast the loop is and however many pins the sketch asks about.
+
+  unsigned long now = millis();
+  if (now - _sensorDataTime < BTUTILS_SENSOR_READ_INTERVAL)
+    return;
+  _sensorDataTime = now;
+
+  // One burst per sensor gets its touch status, filtered and baseline
+  // data, however many of its electrodes are in use.
+
+  STATS_BEGIN(start);
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++)
+    touchSensor(s)->updateAll();
+  STATS_END(STAT_PROXIMITY_SCAN, start);
+
+  PinSet touchedPins = 0;
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++)
+    touchedPins = mergeSensorTouches(touchedPins, s);
+  if (touchedPins != _touchedPins) {
+    _setTouchedPins(touchedPins);
+    _touchStateUnseen = true;	// for the next _readTouchState()
+  }
+
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++)
+    _proximity[pin] = _calculateProximity(pin);
+}
+
+int BtUtils::_calculateProximity(int pinNumber) {
+
+  // Uses the data from the last updateAll() of the pin's sensor.
+
+  // read the difference between the measured baseline and the measured continuous data
+  MPR121_type *sensor = SENSOR_OF(pinNumber);
+  int reading = sensor->getBaselineData(ELECTRODE_OF(pinNumber)) - sensor->getFilteredData(ELECTRODE_OF(pinNumber));
+
+  // constrain the reading between our low and high mapping values
+  ProximityFilter *f = &_proximityFilter[pinNumber];
+  uint8_t prox = constrain(reading, f->low, f->low + (HIGH_DIFF - LOW_DIFF));
+
+  // smooth it with this pin's filter
+  int16_t filtered = _filterProximity(f, prox);
+
+  // map the low..high range to 0..100 (percentage)
+  int thisProximity = (int)(((int32_t)(filtered - (f->low << 8)) * 100) / ((HIGH_DIFF - LOW_DIFF) << 8));
+  if (thisProximity < 0)
+    thisProximity = 0;		// still settling after a new calibration
+
+  return (int)(((int32_t)thisProximity * _proximityMultiplier) >> 8);
+}
+
+int BtUtils::getProximityPercent(int pinNumber) {
+  if (pinNumber < FIRST_PIN || pinNumber > LAST_PIN)
+    return 0;
+  _readSensorData();
+  return _proximity[pinNumber];
+}
+
+int BtUtils::scanProximity(int *proximity, int *closestPin) {
+
+  // Same as calling getProximityPercent() for every pin: all of them come
+  // from the same reading. Fills in proximity[] (if given; it must have
+  // NUM_PINS entries), sets *closestPin (if given) to the pin with the
+  // highest reading or -1 if nothing is near, and returns that highest
+  // reading.
+
+  _readSensorData();
+
+  int highestProximity = 0;
+  int highestProximityPin = -1;
+  for (int pin = FIRST_PIN; pin <= LAST_PIN; pin++) {
+    int p = _proximity[pin];
+    if (proximity)
+      proximity[pin] = p;
+    if (p > highestProximity) {
+      highestProximity = p;
+      highestProximityPin = pin;
+    }
+  }
+  if (closestPin)
+    *closestPin = highestProximityPin;
+  return highestProximity;
+}
+
+int BtUtils::getProximityPinStatus(int *whichPin, int *proximity) {
+
+  // Like getPinTouchStatus(), for a hand moving over the pins: which pin
+  // is it over? Returns NEW_TOUCH when a pin becomes the active one
+  // (*whichPin is that pin), NEW_RELEASE when the hand has left (*whichPin
+  // is the pin it left), and otherwise TOUCH_NO_CHANGE (*whichPin is the
+  // active pin, or -1). *proximity, if given, is the active pin's
+  // proximity. Unlike the closest pin from scanProximity(), the active
+  // pin doesn't flip back and forth when the hand is between two pins;
+  // see setProximitySwitching().
+
+  int closestPin;
+  int closest = scanProximity(NULL, &closestPin);
+  int active = _proximityPin;
+
+  if (active >= 0 && _proximity[active] == 0)
+    active = -1;			// the hand has left it
+  if (active < 0) {
+    active = closestPin;		// the first pin it comes near, at once
+    _proximityChallenger = -1;
+  } else if (!_switchLockOn && closestPin != active
+	     && closest > _proximity[active] + _switchMargin) {
+    if (closestPin != _proximityChallenger) {
+      _proximityChallenger = closestPin;
+      _challengerSince = millis();
+    } else if (millis() - _challengerSince >= _switchDwell) {
+      active = closestPin;
+      _proximityChallenger = -1;
+    }
+  } else {
+    _proximityChallenger = -1;
+  }
+
+  int status = TOUCH_NO_CHANGE;
+  *whichPin = active;
+  if (active != _proximityPin) {
+    if (active >= 0) {
+      status = NEW_TOUCH;
+    } else {
+      status = NEW_RELEASE;
+      *whichPin = _proximityPin;
+    }
+    LOG_DEBUG("proximity pin ", active);
+    _proximityPin = active;
+  }
+  if (proximity)
+    *proximity = (active >= 0) ? _proximity[active] : 0;
+  return status;
+}
+
+void BtUtils::setProximitySwitching(int margin, int dwellMilliseconds, bool lockOn) {
+
+  // How getProximityPinStatus() moves from one pin to another while the
+  // hand is still near the first: another pin has to be closer by more
+  // than margin (in percent), and stay that way for dwellMilliseconds. With
+  // lockOn, it never moves; the hand has to leave the active pin first.
+  // The default is a margin of 10, 100 milliseconds, and no lock-on.
+
+  _switchMargin = constrain(margin, 0, 255);
+  _switchDwell = max(dwellMilliseconds, 0);
+  _switchLockOn = lockOn;
+}
+
+int BtUtils::setProximityMultiplier(float multiplier) {
+  if (multiplier < 0)
+    multiplier = 0;
+  if (multiplier > 255)
+    multiplier = 255;
+  _proximityMultiplier = (uint16_t)(multiplier * 256.0 + 0.5);
+  return 0;
+}
+
+#endif
+
+#if BTUTILS_ENABLE_MIDI
+
+/*----------------------------------------------------------------------
+ * MIDI mode. With the TouchBoard's MIDI jumpers closed, the VS1053 starts
+ * up as a General MIDI synthesizer listening on a serial line, and a note
+ * starts within a millisecond of being sent: there's no file to open and
+ * nothing to buffer. Notes on different pins sound together.
+ ----------------------------------------------------------------------*/
+
+#define MIDI_BAUD_RATE     31250
+#define MIDI_RX_PIN        12	// nothing is read, but SoftwareSerial wants one
+#define MIDI_NOTE_OFF      0x80
+#define MIDI_NOTE_ON       0x90
+#define MIDI_CONTROL       0xB0
+#define MIDI_PROGRAM       0xC0
+#define MIDI_PRESSURE      0xD0
+#define MIDI_CC_BANK       0x00
+#define MIDI_CC_VOLUME     0x07
+#define MIDI_CC_NOTES_OFF  0x7B
+
+static SoftwareSerial _midiSerial(MIDI_RX_PIN, BTUTILS_MIDI_TX_PIN);
+
+void BtUtils::startMidiMode(int instrument) {
+
+  // Call this in setup(), after BtUtils::setup(). instrument is a General
+  // MIDI instrument number (1 is the acoustic grand piano) for channel 1;
+  // use setMidiInstrument() for other channels. From here on, tracks can't
+  // be played; setVolume() still works.
+
+  stopTrack();
+  pinMode(BTUTILS_MIDI_RESET_PIN, OUTPUT);
+  digitalWrite(BTUTILS_MIDI_RESET_PIN, LOW);
+  delay(100);
+  digitalWrite(BTUTILS_MIDI_RESET_PIN, HIGH);
+  delay(100);
+  _midiSerial.begin(MIDI_BAUD_RATE);
+  _midiMode = true;
+  _midiNotesOn = 0;
+  for (uint8_t channel = 0; channel < 16; channel++) {
+    _midiMessage(MIDI_CONTROL | channel, MIDI_CC_BANK, 0);		// General MIDI
+    _midiMessage(MIDI_CONTROL | channel, MIDI_CC_VOLUME, 127);
+  }
+  setMidiInstrument(instrument);
+  LOG_INFO("MIDI mode, instrument ", instrument);
+}
+
+void BtUtils::setMidiInstrument(int instrument, int channel) {
+
+  // instrument is 1 to 128, channel 1 to 16 (channel 10 is drums)
+
+  if (instrument < 1 || instrument > 128 || channel < 1 || channel > 16)
+    return;
+  _midiMessage(MIDI_PROGRAM | (channel - 1), instrument - 1);
+}
+
+void BtUtils::setPinNote(int pinNumber, int note, int channel) {
+
+  // note is 0 to 127 (60 is middle C), channel 1 to 16. By default pins 0
+  // to 11 play notes 60 to 71 on channel 1.
+
+  if (pinNumber < FIRST_PIN || pinNumber > LAST_PIN || note < 0 || note > 127
+      || channel < 1 || channel > 16)
+    return;
+  if (_midiNotesOn & PIN_BIT(pinNumber)) {
+    _midiMessage(MIDI_NOTE_OFF | _midiChannel[pinNumber], _midiNote[pinNumber]);
+    _midiNotesOn &= ~PIN_BIT(pinNumber);
+  }
+  _midiNote[pinNumber] = note;
+  _midiChannel[pinNumber] = channel - 1;
+}
+
+void BtUtils::setMidiVelocity(int velocity) {
+
+  // How hard notes are played, 1 to 127. Zero (the default) plays each
+  // note as hard as the pin's proximity at the moment it's touched, so a
+  // firm press plays louder than a light brush.
+
+#if BTUTILS_ENABLE_PROXIMITY
+  _midiVelocity = constrain(velocity, 0, 127);
+#else
+  _midiVelocity = (velocity > 0) ? min(velocity, 127) : BTUTILS_MIDI_VELOCITY;
+#endif
 }
 
+void BtUtils::playMidiNotes() {
 
-#define LOW_DIFF 0
-#define HIGH_DIFF 50
-#define filterWeight 0.3f // 0.0f to 1.0f - higher value = more smoothing
+  // Call this every time through the loop: a note starts when its pin is
+  // touched and stops when it's released. It reads the touch state, but
+  // getPinTouchStatus(), pollTouchEvent() and updateTouchState() each
+  // compare the pins with what they last reported, so a sketch that uses
+  // one of those too still gets every touch and release.
 
-int BtUtils::getProximityPercent(int pinNumber) {
+  if (!_midiMode)
+    return;
+  _readTouchState();
+  PinSet touchedPins = _touchedPins;	// a proximity read below may change it
+  PinSet notesOff = _midiNotesOn & ~touchedPins;
+  PinSet notesOn  = touchedPins & ~_midiNotesOn;
+  if (!(notesOn | notesOff))
+    return;
 
-  MPR121.updateAll();
+#if BTUTILS_ENABLE_PROXIMITY
+  if (notesOn && _midiVelocity == 0)
+    _readSensorData();
+#endif
 
-  // read the difference between the measured baseline and the measured continuous data
-  int reading = MPR121.getBaselineData(pinNumber)-MPR121.getFilteredData(pinNumber);
+  int pin;
+  while ((pin = takeLowestPin(&notesOff)) >= 0)
+    _midiMessage(MIDI_NOTE_OFF | _midiChannel[pin], _midiNote[pin]);
+  while ((pin = takeLowestPin(&notesOn)) >= 0)
+    _midiMessage(MIDI_NOTE_ON | _midiChannel[pin], _midiNote[pin], _midiNoteVelocity(pin));
+  _midiNotesOn = touchedPins;
+  STATS_PLAYING();
+}
 
-  // constrain the reading between our low and high mapping values
-  unsigned int prox = constrain(reading, LOW_DIFF, HIGH_DIFF);
-  
-  // implement a simple (IIR lowpass) smoothing filter
-  _lastProximity = (filterWeight*_lastProximity) + ((1-filterWeight)*(float)prox);
+void BtUtils::stopMidiNotes() {
 
-  // map the LOW_DIFF..HIGH_DIFF range to 0..100 (percentage)
-  int thisProximity = map(_lastProximity, LOW_DIFF, HIGH_DIFF, 0, 100);
+  // Silences everything, e.g. before a sketch changes instruments.
 
-  return (int)((float)thisProximity*_proximityMultiplier);
+  if (!_midiMode)
+    return;
+  for (uint8_t channel = 0; channel < 16; channel++)
+    _midiMessage(MIDI_CONTROL | channel, MIDI_CC_NOTES_OFF, 0);
+  _midiNotesOn = _touchedPins;	// held pins don't start again until touched again
 }
 
-int BtUtils::setProximityMultiplier(float multiplier) {
-  _proximityMultiplier = multiplier;
+uint8_t BtUtils::_midiNoteVelocity(int pinNumber) {
+#if BTUTILS_ENABLE_PROXIMITY
+  if (_midiVelocity == 0)
+    return constrain((_proximity[pinNumber] * 127) / 100, 1, 127);
+#else
+  (void)pinNumber;
+#endif
+  return _midiVelocity;
+}
+
+void BtUtils::_midiMessage(uint8_t command, uint8_t data1, uint8_t data2) {
+
+  // Three bytes take about a millisecond at MIDI speed. Program change and
+  // channel pressure have only one data byte.
+
+  _midiSerial.write(command);
+  _midiSerial.write(data1);
+  uint8_t type = command & 0xF0;
+  if (type != MIDI_PROGRAM && type != MIDI_PRESSURE)
+    _midiSerial.write(data2);
 }
 
+#endif
+
 /*----------------------------------------------------------------------
  * Volume controls
  ----------------------------------------------------------------------*/
 
+// What to do when a fade is finished
+#define FADE_END_NONE  0
+#define FADE_END_PAUSE 1
+#define FADE_END_STOP  2
+#define FADE_END_SWITCH 3		// start _switchTrack
+
 // Convert the volume, range is 0 to 100 (percent).  The MIDI player sets
 // volume in 254 increments (254 is minimum, 0 is maximum), each step being
 // -2dB, so it's an exponential scale. The heurist 1/10x^1.5 function below
 // (offset and scaled so that zero is zero and 100 is max) reverses this a
 // bit, making it sound more linear.
+//
+// The function is worked out ahead of time for every percentage and kept in
+// flash memory, since pow() is very slow on the TouchBoard (which has no
+// floating-point hardware). The table was made with:
+//
+//   p = percent/100.0
+//   p = (1 - (1/(pow(10.0*(p+0.1), 1.5))))/0.974
+//   b = (uint8_t)((1.0 - p) * 254.0)
+
+static const uint8_t volumePctToByteTable[101] PROGMEM = {
+  254, 219, 191, 169, 150, 135, 122, 110, 101,  92,	//  0 -  9%
+   85,  78,  73,  67,  63,  59,  55,  51,  48,  46,	// 10 - 19%
+   43,  40,  38,  36,  34,  33,  31,  29,  28,  27,	// 20 - 29%
+   25,  24,  23,  22,  21,  20,  19,  18,  18,  17,	// 30 - 39%
+   16,  15,  15,  14,  14,  13,  12,  12,  11,  11,	// 40 - 49%
+   10,  10,  10,   9,   9,   8,   8,   8,   7,   7,	// 50 - 59%
+    7,   7,   6,   6,   6,   5,   5,   5,   5,   4,	// 60 - 69%
+    4,   4,   4,   4,   3,   3,   3,   3,   3,   3,	// 70 - 79%
+    2,   2,   2,   2,   2,   2,   1,   1,   1,   1,	// 80 - 89%
+    1,   1,   1,   1,   0,   0,   0,   0,   0,   0,	// 90 - 99%
+    0							// 100%
+};
 
 uint8_t BtUtils::_volumePctToByte(int percent) {
   if (percent > 100)	// max volume
     percent = 100;
   else if (percent < 0) // min volume
     percent = 0;
-  float p = (float)percent/100.0;
-  p = (1 - (1/(pow(10.0*(p+0.1), 1.5))))/0.974;
-  uint8_t b = ((1.0 - p) * 254.0);
-  LOG_ACTION("_volumePctToByte percent: ", percent);
-  LOG_ACTION("_volumePctToByte byte:    ", b);
+  uint8_t b = pgm_read_byte(&volumePctToByteTable[percent]);
+  LOG_DEBUG("_volumePctToByte percent: ", percent);
+  LOG_DEBUG("_volumePctToByte byte:    ", b);
   return b;
 }
 
-void BtUtils::_setActualVolume(int percent) {
-  uint8_t volume = _volumePctToByte(percent);
-  _MP3player->setVolume(volume);
-  _actualVolume = percent;
+static int clampVolume(int percent) {
+  if (percent > 100)
+    return 100;
+  if (percent < 0)
+    return 0;
+  return percent;
+}
+
+void BtUtils::setVolumeUpdateInterval(int milliseconds) {
+
+  // The MP3 player's volume is changed at most once every this many
+  // milliseconds. Changes in between are held back and the latest one is
+  // sent when the time is up (from doTimerTasks()), so the final volume
+  // always gets there. Zero means send every change right away.
+
+  _volumeWriteInterval = (milliseconds > 0) ? milliseconds : 0;
+}
+
+void BtUtils::_writeVolume(bool immediately) {
+
+  // Both channels go to the MP3 player in one write, and only if one of
+  // them actually changed; during a fade most percentage steps map to the
+  // same volume byte, so this saves a lot of needless writes.
+
+  uint8_t left = _volumePctToByte(_actualVolumeLeft);
+  uint8_t right = _volumePctToByte(_actualVolumeRight);
+  if (left == _volumeByteLeft && right == _volumeByteRight) {
+    _volumeWritePending = false;
+    return;
+  }
+  unsigned long now = millis();
+  if (!immediately && _volumeWriteInterval > 0 && now - _lastVolumeWriteTime < _volumeWriteInterval) {
+    _setTimer(TIMER_VOLUME, _lastVolumeWriteTime + _volumeWriteInterval);
+    _volumeWritePending = true;
+    return;
+  }
+  STATS_BEGIN(start);
+  _MP3player->setVolume(left, right);
+  STATS_END(STAT_PLAYER, start);
+  _volumeByteLeft = left;
+  _volumeByteRight = right;
+  _lastVolumeWriteTime = now;
+  _volumeWritePending = false;
+}
+
+void BtUtils::_setActualVolume(int leftPercent, int rightPercent, bool immediately) {
+  _actualVolumeLeft = leftPercent;
+  _actualVolumeRight = rightPercent;
+  _writeVolume(immediately);
 }
 
 void BtUtils::_setVolume(int leftPercent, int rightPercent) {
-  _targetVolume = leftPercent;
-  _setActualVolume(leftPercent);
+  _targetVolumeLeft = leftPercent;
+  _targetVolumeRight = rightPercent;
+  _setActualVolume(leftPercent, rightPercent);
 }
 
 void BtUtils::setVolume(int leftPercent, int rightPercent) {
-  LOG_ACTION("set volume percent: ", leftPercent);
+  leftPercent = clampVolume(leftPercent);
+  rightPercent = clampVolume(rightPercent);
+
+  // Sketches often set the volume every time through the loop; if nothing
+  // changed, there's nothing to do, except send the last change if it was
+  // held back and is now due (so it gets there even if the sketch doesn't
+  // call doTimerTasks()).
+
+  if (leftPercent == _targetVolumeLeft && rightPercent == _targetVolumeRight
+      && (_isFading() || (leftPercent == _actualVolumeLeft && rightPercent == _actualVolumeRight))) {
+    if (_volumeWritePending)
+      _writeVolume(false);
+    return;
+  }
+
+  LOG_INFO("set volume percent: ", leftPercent);
+  if (_seekState == SEEK_WAITING) {	// stays silent until the skip is done
+    _targetVolumeLeft = leftPercent;
+    _targetVolumeRight = rightPercent;
+    return;
+  }
+#if BTUTILS_ENABLE_FADES
+  if (_fade.active) {
+
+    // Fading in: head for the new volume from wherever the fade has got
+    // to. Fading out: keep going; the new volume is used on resume.
+
+    _targetVolumeLeft = leftPercent;
+    _targetVolumeRight = rightPercent;
+    if (_fade.endAction == FADE_END_NONE)
+      _startFade(leftPercent, rightPercent,
+		 _scaledFadeTime(_fadeInTime, leftPercent, rightPercent), FADE_END_NONE);
+    return;
+  }
+#endif
   _setVolume(leftPercent, rightPercent);
 }
 
@@ -322,7 +1430,7 @@ void BtUtils::setVolume(int percent) {
   setVolume(percent, percent);
 }
 
-#ifdef BTUTILS_ENABLE_FADES
+#if BTUTILS_ENABLE_FADES
 
 void BtUtils::setFadeInTime(int milliseconds) {
   _fadeInTime = milliseconds;
@@ -332,95 +1440,178 @@ void BtUtils::setFadeOutTime(int milliseconds) {
   _fadeOutTime = milliseconds;
 }
 
-int BtUtils::_calculateFadeTime(bool goingUp) {
-  int deltaVolume;
-  int fadeTime;
-  if (goingUp) {
-    deltaVolume = 100 - _actualVolume;
-    fadeTime = _fadeInTime;
-  } else {
-    deltaVolume = _actualVolume;
-    fadeTime = _fadeOutTime;
-  }
-  int time = (int)(0.499 + (float)fadeTime * (float)deltaVolume/100.0);
-  return time;
+void BtUtils::setSwitchFadeTime(int milliseconds) {
+
+  // How long the track that's playing fades out for when startTrack()
+  // switches to another. Zero (the default) cuts it off, so the new track
+  // starts as soon as it can; the fade-out time is only for stopping and
+  // pausing. The new track is opened after the fade, not during it, so a
+  // switch takes the fade time plus the usual start time.
+
+  _switchFadeTime = milliseconds;
 }
 
-void BtUtils::_doVolumeFadeInAndOut() {
+void BtUtils::setFadeCurve(int curve) {
+  if (curve < FADE_CURVE_LINEAR || curve > FADE_CURVE_EQUAL_POWER)
+    curve = FADE_CURVE_LINEAR;
+  _fadeCurve = curve;
+}
+
+void BtUtils::fadeToVolume(int leftPercent, int rightPercent, int milliseconds) {
+  leftPercent = clampVolume(leftPercent);
+  rightPercent = clampVolume(rightPercent);
+  LOG_INFO("fade to volume percent: ", leftPercent);
+  _targetVolumeLeft = leftPercent;
+  _targetVolumeRight = rightPercent;
+  _startFade(leftPercent, rightPercent, milliseconds, FADE_END_NONE);
+}
 
-  // Do fade-in?
+void BtUtils::fadeToVolume(int percent, int milliseconds) {
+  fadeToVolume(percent, percent, milliseconds);
+}
 
-  if (_lastStartTime > 0 && _fadeInTime != 0 && _playerStatus == IS_PLAYING && _actualVolume < _targetVolume) {
+// Fade curves: how far along from the start volume to the end volume
+// (0 to 255) the fade is at each sixteenth of the fade time. In between,
+// the value is interpolated. These are for fading in; a fade-out uses the
+// same curve backwards, so it sounds like the fade-in played in reverse.
+//
+//   linear:      x
+//   exponential: (2^(4x) - 1) / 15     (starts slowly)
+//   S-curve:     3x^2 - 2x^3           (slow at both ends)
+//   equal power: sin(x * pi/2)         (for cross-fading two tracks)
+
+static const uint8_t fadeCurveTable[4][17] PROGMEM = {
+  { 0,  16,  32,  48,  64,  80,  96, 112, 128, 143, 159, 175, 191, 207, 223, 239, 255 },
+  { 0,   3,   7,  12,  17,  23,  31,  40,  51,  64,  79,  97, 119, 145, 175, 212, 255 },
+  { 0,   3,  11,  24,  40,  59,  81, 104, 128, 151, 174, 196, 215, 231, 244, 252, 255 },
+  { 0,  25,  50,  74,  98, 120, 142, 162, 180, 197, 212, 225, 236, 244, 250, 254, 255 },
+};
+
+static uint8_t fadeCurveValue(uint8_t curve, uint16_t progress, bool goingUp) {
+
+  // progress is 0 (start) to 256 (done)
+
+  if (!goingUp)
+    progress = 256 - progress;
+  uint8_t i = progress >> 4;
+  uint8_t fraction = progress & 0x0F;
+  uint8_t a = pgm_read_byte(&fadeCurveTable[curve][i]);
+  uint8_t b = (i < 16) ? pgm_read_byte(&fadeCurveTable[curve][i+1]) : a;
+  uint8_t value = a + (uint8_t)(((b - a) * fraction) >> 4);
+  return goingUp ? value : 255 - value;
+}
 
-    // Calculate the target volume based on how much elapsed time since the track started playing.
-    // But if _thisFadeInTime is different that _fadeInTime, it means we started with non-zero
-    // volume, so push the elapsed time forward by difference of the two.
+int BtUtils::_scaledFadeTime(int fullFadeTime, int toLeft, int toRight) {
 
-    unsigned long elapsedTime = millis() - _lastStartTime;
-    if (_fadeInTime != _thisFadeInTime) {
-      elapsedTime += _fadeInTime - _thisFadeInTime;	// push elapsed time forward to adjust for non-zero start volume
-    }
-    
-    int newVolumePercent = int((float)_targetVolume*(float)elapsedTime/(float)_fadeInTime);
-    
-    // Time to increase volume?
-    
-    if (newVolumePercent != _actualVolume) {
-      if (newVolumePercent >= _targetVolume) {
-	newVolumePercent = _targetVolume;
-      }
-      LOG_ACTION("Set volume: ", newVolumePercent);
-      _setActualVolume(newVolumePercent);
-    }
+  // The fade-in and fade-out times are for a full fade, between zero and
+  // the volume that was set. A fade that starts part way (e.g. a fade-out
+  // that is interrupted by a resume) takes proportionally less time. With
+  // different left/right volumes, the channel with further to go decides.
+
+  int range = max(_targetVolumeLeft, _targetVolumeRight);
+  if (range <= 0)
+    range = 100;
+  int delta = max(abs(toLeft - _actualVolumeLeft), abs(toRight - _actualVolumeRight));
+  if (delta >= range)
+    return fullFadeTime;
+  return (int)(((long)fullFadeTime * delta + range/2) / range);
+}
+
+void BtUtils::_startFade(int toLeft, int toRight, int milliseconds, uint8_t endAction) {
+
+  // Starts from whatever the volume is now, so a fade that replaces one
+  // that was still going on carries on smoothly from where that one got to.
+
+  _fade.fromLeft = _actualVolumeLeft;
+  _fade.fromRight = _actualVolumeRight;
+  _fade.toLeft = toLeft;
+  _fade.toRight = toRight;
+  _fade.curve = _fadeCurve;
+  _fade.endAction = endAction;
+  if (endAction != FADE_END_SWITCH)
+    _switchTrack = -1;		// a pause, stop, etc. replaces the switch
+  _fade.startTime = millis();
+  _fade.duration = (milliseconds > 0) ? milliseconds : 0;
+  _fade.active = true;
+  if (_fade.duration == 0 || (_fade.fromLeft == toLeft && _fade.fromRight == toRight))
+    _finishFade();
+  else
+    _setTimer(TIMER_FADE, _fade.startTime);
+}
+
+void BtUtils::_finishFade() {
+  _fade.active = false;
+  _setActualVolume(_fade.toLeft, _fade.toRight, true);
+  if (_fade.endAction == FADE_END_PAUSE) {
+    _MP3player->pauseMusic();
+    LOG_INFO("fade-out done, track paused: ", _lastTrackPlayed);
+  } else if (_fade.endAction == FADE_END_STOP) {
+    _MP3player->stopTrack();
+    LOG_INFO("fade-out done, track stopped: ", _lastTrackPlayed);
+  } else if (_fade.endAction == FADE_END_SWITCH && _switchTrack >= 0) {
+    int track = _switchTrack;
+    _switchTrack = -1;
+    LOG_INFO("fade-out done, switching to track ", track);
+    startTrack(track, _switchLocation);	// silent now, so it starts at once
   }
+}
 
-  // Else -- do fade-out?
+static int fadeStep(int from, int to, uint8_t curve, uint16_t progress) {
+  uint8_t f = fadeCurveValue(curve, progress, to > from);
+  return from + (int)(((long)(to - from) * f) / 255);
+}
 
-  else if (_lastStopTime > 0 && (_playerStatus == IS_STOPPED || _playerStatus == IS_PAUSED)
-	   && _fadeOutTime != 0 && _actualVolume > 0) {
+void BtUtils::_doVolumeFadeInAndOut() {
 
-    // Calculate the target volume based on how much elapsed time since the track stopped playing.
-    // But if _thisFadeOutTime is different than _fadeOutTime, it means we started with volume less
-    // than 100%, so push elapsed time forward by the difference of the two.
+  if (!_fade.active)
+    return;
 
-    unsigned long elapsedTime = millis() - _lastStopTime;
-    if (_fadeOutTime != _thisFadeOutTime) {
-      elapsedTime += _fadeOutTime - _thisFadeOutTime;
-    }
+  unsigned long elapsedTime = millis() - _fade.startTime;
+  if (elapsedTime >= _fade.duration) {
+    _finishFade();
+    return;
+  }
 
-    int newVolumePercent = _targetVolume - int((float)(_targetVolume)*(float)elapsedTime/(float)_fadeOutTime);
-
-    // Time to decrease volume?
-
-    if (newVolumePercent != _actualVolume) {
-      LOG_ACTION("Set volume: ", newVolumePercent);
-      Serial.print("Set volume: "); Serial.println(newVolumePercent);
-      if (newVolumePercent <= 0) {
-	newVolumePercent = 0;
-	if (_playerStatus == IS_PAUSED) {
-	  _MP3player->pauseMusic();
-	  LOG_ACTION("fade-out done, track paused: ", _lastTrackPlayed);
-	  Serial.print("fade-out done, track paused: "); Serial.println(_lastTrackPlayed);
-	} else {
-	  _MP3player->stopTrack();
-	  LOG_ACTION("fade-out done, track stopped: ", _lastTrackPlayed);
-	  Serial.print("fade-out done, track stopped: "); Serial.println(_lastTrackPlayed);
-	}
-      }
-      _setActualVolume(newVolumePercent);
-    }
+  // Where along the curve are we? (0 to 256)
+  uint16_t progress = (uint16_t)((elapsedTime << 8) / _fade.duration);
+  int left = fadeStep(_fade.fromLeft, _fade.toLeft, _fade.curve, progress);
+  int right = fadeStep(_fade.fromRight, _fade.toRight, _fade.curve, progress);
+
+  if (left != _actualVolumeLeft || right != _actualVolumeRight) {
+    LOG_DEBUG("Set volume: ", left);
+    _setActualVolume(left, right);
   }
+  _setTimer(TIMER_FADE, millis() + FADE_STEP_TIME);
+}
+#endif
+
+void BtUtils::_cancelFade() {
+#if BTUTILS_ENABLE_FADES
+  _fade.active = false;
+  _switchTrack = -1;
+#endif
 }
+
+bool BtUtils::_isFading() {
+#if BTUTILS_ENABLE_FADES
+  return _fade.active;
+#else
+  return false;
 #endif
+}
 
 /*----------------------------------------------------------------------
  * Queuing, start, stop, resume of tracks
  ----------------------------------------------------------------------*/
 
 int BtUtils::getPlayerStatus() {
-  if ((_playerStatus == IS_PLAYING || _playerStatus == IS_PAUSED) && _MP3player->isPlaying() != 1) {
+  if ((_playerStatus == IS_PLAYING || _playerStatus == IS_PAUSED) && _seekState != SEEK_ABANDONED
+      && _MP3player->isPlaying() != 1) {
     _playerStatus = IS_STOPPED;
-    LOG_ACTION("player finished track: ", _lastTrackPlayed);
+#if BTUTILS_ENABLE_RESUME
+    _saveTrackLocation(true);		// played to the end: start over next time
+#endif
+    LOG_INFO("player finished track: ", _lastTrackPlayed);
   }
   return _playerStatus;
 }
@@ -430,6 +1621,8 @@ int BtUtils::getLastTrackPlayed() {
 }
 
 uint32_t BtUtils::getCurrentTrackLocation() {
+  if (_seekState != SEEK_IDLE)
+    return _seekLocation;
   int status = getPlayerStatus();
   if (status == IS_PLAYING || status == IS_PAUSED) {
     return _MP3player->currentPosition();
@@ -440,44 +1633,100 @@ uint32_t BtUtils::getCurrentTrackLocation() {
 
 #if BTUTILS_ENABLE_START_AFTER_DELAY
 void BtUtils::queueTrackToStartAfterDelay(int trackNumber) {
-  LOG_ACTION("queue track, waiting for timeout, track ", trackNumber);
+  LOG_INFO("queue track, waiting for timeout, track ", trackNumber);
   if (_MP3player->isPlaying()) {
     _MP3player->stopTrack();
   }
+  _cancelFade();
   _lastTrackPlayed = trackNumber;
   _lastStartTime = millis();
   _lastStopTime = 0;
   _lastActionTime = _lastStartTime;
   _playerStatus = IS_WAITING;
+  if (_startDelay > 0)
+    _setTimer(TIMER_START_DELAY, _lastStartTime + _startDelay);
 }
 #endif
 
 void BtUtils::startTrack(int trackNumber, uint32_t location) {
-  LOG_ACTION("start track ", trackNumber);
-  if (_fadeInTime > 0) {
-    _setActualVolume(0);       // fade-in: start with zero
-    _thisFadeInTime = _fadeInTime;
-  } else {
-    _setVolume(_targetVolume, _targetVolume);   // normal: start with full requested volume
+  LOG_INFO("start track ", trackNumber);
+#if BTUTILS_ENABLE_MIDI
+  if (_midiMode) {
+    LOG_ERROR("MIDI mode, can't play track ", trackNumber);
+    return;
+  }
+#endif
+#if BTUTILS_ENABLE_TRACK_CATALOG
+  if (!trackExists(trackNumber)) {
+    LOG_ERROR("no such track: ", trackNumber);
+    return;
+  }
+#endif
+#if BTUTILS_ENABLE_FADES
+  if (_switchTrack == trackNumber && _switchLocation == location)
+    return;				// already on its way (see below)
+#endif
+#if BTUTILS_ENABLE_RESUME
+  if (trackNumber != _lastTrackPlayed && (_playerStatus == IS_PLAYING || _playerStatus == IS_PAUSED))
+    _saveTrackLocation(false);
+#endif
+#if BTUTILS_ENABLE_FADES
+  if (_switchFadeTime > 0 && _seekState == SEEK_IDLE && getPlayerStatus() == IS_PLAYING
+      && (_actualVolumeLeft > 0 || _actualVolumeRight > 0)) {
+
+    // Switching from a track that can be heard: fade it out first, and
+    // _finishFade() starts this one when it's silent, so the two never
+    // sound cut off. Meanwhile the loop carries on, and the sketch asking
+    // for this track again changes nothing. (The MP3 player streams one
+    // file at a time, so this one can't be opened any sooner.)
+
+    _switchTrack = trackNumber;
+    _switchLocation = location;
+    _lastActionTime = millis();
+    _startFade(0, 0, _scaledFadeTime(_switchFadeTime, 0, 0), FADE_END_SWITCH);
+    return;
+  }
+#endif
+  _cancelFade();
+  _seekState = SEEK_IDLE;
+  if (location) {
+    _setActualVolume(0, 0, true);	// silent until _doPendingSeek() gets there
+  }
+#if BTUTILS_ENABLE_FADES
+  else if (_fadeInTime > 0) {
+    _setActualVolume(0, 0, true);       // fade-in: start with zero
+    _startFade(_targetVolumeLeft, _targetVolumeRight, _fadeInTime, FADE_END_NONE);
+  }
+#endif
+  else {
+    _setVolume(_targetVolumeLeft, _targetVolumeRight);   // normal: start with full requested volume
   }
+  STATS_BEGIN(start);
   if (_MP3player->isPlaying()) {
     _MP3player->stopTrack();
   }
+  STATS_END(STAT_PLAYER, start);
+
+  // playTrack() finds the file, reads through any ID3 tag to the first
+  // MPEG frame and fills the codec's buffer before it returns, so this is
+  // the time from here to the first sound.
+
+  STATS_BEGIN(opened);
   _MP3player->playTrack(trackNumber);
+  STATS_END(STAT_TRACK_START, opened);
+  if (location == 0)
+    STATS_PLAYING();
   if (location) {
-    
-    // Note to self: This skipTo() feature just doesn't work. It has to have been playing
-    // for at least 1 second or thereabouts before the MP3 player knows where it is; prior
-    // to that it just ignores the skipTo() function. Not only that, but once you do skipTo(),
-    // subsequent getCurrentTrackLocation() calls return the DIFFERENCE from where you last
-    // started, not the actual location! So this one-second delay is necessary, and basically
-    // makes the feature useless.
-    delay(900);
-    _MP3player->skipTo(location);
-    delay(100);
-    //if (_MP3player->isPlaying() != 1) {	// did it happen to reach the end?
-    //  stopTrack();
-    //}
+
+    // The MP3 player ignores skipTo() until it has been playing long
+    // enough to know the track's bit rate (up to a second or so). Rather
+    // than wait here, the track plays silently and doTimerTasks() does the
+    // skip when it can, then turns up the volume.
+
+    _seekState = SEEK_WAITING;
+    _seekLocation = location;
+    _seekStartTime = millis();
+    _setTimer(TIMER_SEEK, _seekStartTime + SEEK_MIN_WAIT);
   }
   _lastTrackPlayed = trackNumber;
   _lastStartTime = millis();
@@ -486,39 +1735,98 @@ void BtUtils::startTrack(int trackNumber, uint32_t location) {
   _playerStatus = IS_PLAYING;
 }
 
+void BtUtils::_startVolumeAfterSeek() {
+#if BTUTILS_ENABLE_FADES
+  if (_fadeInTime > 0) {
+    _startFade(_targetVolumeLeft, _targetVolumeRight, _fadeInTime, FADE_END_NONE);
+    return;
+  }
+#endif
+  _setActualVolume(_targetVolumeLeft, _targetVolumeRight, true);
+}
+
+void BtUtils::_doPendingSeek() {
+  if (_seekState != SEEK_WAITING)
+    return;
+  unsigned long elapsedTime = millis() - _seekStartTime;
+  if (elapsedTime < SEEK_MAX_WAIT
+      && (elapsedTime < SEEK_MIN_WAIT || _MP3player->Mp3ReadWRAM(para_byteRate) == 0)) {
+    _setTimer(TIMER_SEEK, millis() + SEEK_POLL_TIME);
+    return;				// decoder doesn't know the bit rate yet
+  }
+  _seekState = SEEK_IDLE;
+  if (_MP3player->isPlaying() != 1)	// track already over?
+    return;
+  LOG_INFO("skip to location (seconds): ", (int)(_seekLocation / 1000));
+  STATS_BEGIN(start);
+  _MP3player->skipTo(_seekLocation);
+  STATS_END(STAT_PLAYER, start);
+  STATS_PLAYING();
+  _startVolumeAfterSeek();
+}
+
 void BtUtils::resumeTrack() {
-  LOG_ACTION("resume track ", _lastTrackPlayed);
+  LOG_INFO("resume track ", _lastTrackPlayed);
   if (_lastTrackPlayed < 0) {
     startTrack(0);
+    return;
   } else if (_lastActionTime > 0 && _startOverIfIdleTime > 0) {
     unsigned long lastActionElapsed = millis() - _lastActionTime;
     if (lastActionElapsed >= _startOverIfIdleTime) {
-      LOG_ACTION("startOverIfIdleTime exceeded, restarting track: ", _lastTrackPlayed);
+      LOG_INFO("startOverIfIdleTime exceeded, restarting track: ", _lastTrackPlayed);
       startTrack(_lastTrackPlayed);
       return;
     }
   }
-  LOG_ACTION("resume track: resume player, ", _lastTrackPlayed);
+  if (_seekState == SEEK_ABANDONED) {
+    startTrack(_lastTrackPlayed, _seekLocation);
+    return;
+  }
+  LOG_INFO("resume track: resume player, ", _lastTrackPlayed);
+  STATS_BEGIN(start);
   _MP3player->resumeMusic();
+  STATS_END(STAT_PLAYER, start);
+  STATS_PLAYING();
   _playerStatus = IS_PLAYING;
-#ifdef BTUTILS_ENABLE_FADES
-  _thisFadeInTime = _calculateFadeTime(true);
+#if BTUTILS_ENABLE_FADES
+  if (_fadeInTime > 0) {
+    _startFade(_targetVolumeLeft, _targetVolumeRight,
+	       _scaledFadeTime(_fadeInTime, _targetVolumeLeft, _targetVolumeRight), FADE_END_NONE);
+  } else
 #endif
+  {
+    _cancelFade();
+    _setActualVolume(_targetVolumeLeft, _targetVolumeRight);
+  }
   _lastStartTime = millis();
   _lastStopTime = 0;
   _lastActionTime = millis();
 }
 
 void BtUtils::pauseTrack() {
-  LOG_ACTION("pause track ", _lastTrackPlayed);
-  if (_fadeOutTime == 0) {
-    _MP3player->pauseMusic();
-  } else {
-#ifdef BTUTILS_ENABLE_FADES
-    _thisFadeOutTime = _calculateFadeTime(false);
+  LOG_INFO("pause track ", _lastTrackPlayed);
+#if BTUTILS_ENABLE_RESUME
+  _saveTrackLocation(false);
 #endif
+  if (_seekState == SEEK_WAITING) {
+
+    // Paused before it got to the location: nothing has been heard yet,
+    // so just stop, and start over at the same location on resume.
+
+    _seekState = SEEK_ABANDONED;
+    _cancelFade();
+    _MP3player->stopTrack();
+  } else
+#if BTUTILS_ENABLE_FADES
+  if (_fadeOutTime > 0) {
     _lastStopTime = millis();
     _lastStartTime = 0;
+    _startFade(0, 0, _scaledFadeTime(_fadeOutTime, 0, 0), FADE_END_PAUSE);
+  } else
+#endif
+  {
+    _cancelFade();
+    _MP3player->pauseMusic();
   }
   _lastActionTime = millis();
   _playerStatus = IS_PAUSED;
@@ -527,23 +1835,29 @@ void BtUtils::pauseTrack() {
 void BtUtils::stopTrack() {
   if (_playerStatus == IS_STOPPED)
     return;
-  LOG_ACTION("stop track ", _lastTrackPlayed);
+  LOG_INFO("stop track ", _lastTrackPlayed);
+#if BTUTILS_ENABLE_RESUME
+  _saveTrackLocation(true);
+#endif
+  _seekState = SEEK_IDLE;
   _playerStatus = IS_STOPPED;
   _lastTrackPlayed = -1;
+#if BTUTILS_ENABLE_FADES
   if (_fadeOutTime > 0) {
-#ifdef BTUTILS_ENABLE_FADES
-    _thisFadeOutTime = _calculateFadeTime(false);
-#endif
     _lastStopTime = millis();
     _lastStartTime = 0;
-  } else {
+    _startFade(0, 0, _scaledFadeTime(_fadeOutTime, 0, 0), FADE_END_STOP);
+  } else
+#endif
+  {
+    _cancelFade();
     _MP3player->stopTrack();
   }
   _lastActionTime = _lastStopTime;
 }
 
 void BtUtils::startOverAfterNoTouchTime(int seconds) {
-  LOG_ACTION("startOverAfterNoTouchTime = ", seconds);
+  LOG_INFO("startOverAfterNoTouchTime = ", seconds);
   if (seconds < 0) {
     _startOverIfIdleTime = -1;
   } else {
@@ -552,11 +1866,262 @@ void BtUtils::startOverAfterNoTouchTime(int seconds) {
 }
 
 
+#if BTUTILS_ENABLE_TRACK_CATALOG
+
+/*----------------------------------------------------------------------
+ * Track catalog: one pass over the SD card's root directory at setup()
+ * finds every trackNNN.mp3, so that a missing track is known without
+ * searching the whole directory again, and each track's length is known
+ * before it's played.
+ ----------------------------------------------------------------------*/
+
+// Bit rates of MPEG layer III frames, in kbps, by the header's bit rate index
+static const uint16_t mpeg1BitRates[16] PROGMEM = {
+  0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0
+};
+static const uint16_t mpeg2BitRates[16] PROGMEM = {
+  0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0
+};
+
+// A track starts late if the MP3 player has to feed a big ID3 tag (e.g.
+// album art) to the codec before the first sound, or has to read many
+// directory blocks (16 entries each) to find the file. Such tracks are
+// pointed out when the catalog is built.
+#define SLOW_START_TAG_SIZE  4096
+#define SLOW_START_DIR_INDEX 64
+
+void BtUtils::_buildTrackCatalog() {
+  SdFile file;
+  char name[13];
+  int found = 0;
+  STATS_BEGIN(start);
+
+  _sd->vwd()->rewind();
+  while (file.openNext(_sd->vwd(), O_READ)) {
+    if (file.isFile() && file.getSFN(name)
+	&& strncmp(name, "TRACK", 5) == 0 && strcmp(name + 8, ".MP3") == 0
+	&& isdigit(name[5]) && isdigit(name[6]) && isdigit(name[7])) {
+      int trackNumber = (name[5] - '0') * 100 + (name[6] - '0') * 10 + (name[7] - '0');
+      if (trackNumber < BTUTILS_TRACK_CATALOG_SIZE) {
+	TrackInfo *info = &_trackCatalog[trackNumber];
+	info->size = file.fileSize();
+	_readTrackInfo(&file, info);
+	if (info->audioStart > SLOW_START_TAG_SIZE)
+	  LOG_INFO("slow start, big ID3 tag: track ", trackNumber);
+	if (file.dirIndex() > SLOW_START_DIR_INDEX)
+	  LOG_INFO("slow start, far down the directory: track ", trackNumber);
+	found++;
+      }
+    }
+    file.close();
+  }
+  _catalogBuilt = true;
+  STATS_END(STAT_SD_CARD, start);
+  LOG_INFO("tracks found: ", found);
+}
+
+void BtUtils::_readTrackInfo(SdFile *file, TrackInfo *info) {
+
+  // Skips over an ID3v2 tag, if there is one, and reads the bit rate from
+  // the first MPEG frame header after it. A VBR file gives the bit rate of
+  // its first frame, so its length is only a rough guess.
+
+  uint8_t header[10];
+  info->audioStart = 0;
+  info->kbps = 0;
+  if (file->read(header, sizeof(header)) != sizeof(header))
+    return;
+  if (header[0] == 'I' && header[1] == 'D' && header[2] == '3') {
+    info->audioStart = 10
+      + ((uint32_t)(header[6] & 0x7F) << 21) + ((uint32_t)(header[7] & 0x7F) << 14)
+      + ((uint32_t)(header[8] & 0x7F) << 7) + (header[9] & 0x7F);
+    if (header[5] & 0x10)
+      info->audioStart += 10;	// footer
+    if (!file->seekSet(info->audioStart) || file->read(header, 4) != 4)
+      return;
+  }
+  if (header[0] != 0xFF || (header[1] & 0xE0) != 0xE0 || (header[1] & 0x06) != 0x02)
+    return;			// not the start of a layer III frame
+  const uint16_t *bitRates = (header[1] & 0x08) ? mpeg1BitRates : mpeg2BitRates;
+  info->kbps = pgm_read_word(&bitRates[header[2] >> 4]);
+}
+
+bool BtUtils::trackExists(int trackNumber) {
+
+  // Tracks beyond the catalog, or any track if the catalog couldn't be
+  // built, are assumed to be there; the MP3 player will find out.
+
+  if (!_catalogBuilt || trackNumber < 0 || trackNumber >= BTUTILS_TRACK_CATALOG_SIZE)
+    return trackNumber >= 0;
+  return _trackCatalog[trackNumber].size != 0;
+}
+
+uint32_t BtUtils::getTrackLength(int trackNumber) {
+
+  // Length of the track in milliseconds, or 0 if it isn't known.
+
+  if (!_catalogBuilt || trackNumber < 0 || trackNumber >= BTUTILS_TRACK_CATALOG_SIZE)
+    return 0;
+  TrackInfo *info = &_trackCatalog[trackNumber];
+  if (info->kbps == 0 || info->size <= info->audioStart)
+    return 0;
+  return (info->size - info->audioStart) / info->kbps * 8;
+}
+
+#endif
+
+#if BTUTILS_ENABLE_RESUME
+
+/*----------------------------------------------------------------------
+ * Resume: remember where each track was left
+ ----------------------------------------------------------------------*/
+
+#define RESUME_FILE_NAME "RESUME.DAT"
+static const uint8_t resumeFileHeader[4] = {'B', 'T', 'R', NUM_PINS};
+
+void BtUtils::setResumeMode(int mode) {
+
+  // RESUME_NONE:       every touch starts the track from the beginning
+  // RESUME_SINGLE:     the track that was paused resumes, others start over
+  // RESUME_EACH_TRACK: every track resumes where it was left
+
+  LOG_INFO("resume mode: ", mode);
+  _resumeMode = mode;
+}
+
+void BtUtils::forgetSavedTrackLocations() {
+  memset(_savedTrackLocation, 0, sizeof(_savedTrackLocation));
+  memset(_savedTrackTime, 0, sizeof(_savedTrackTime));
+  _trackLocationsChanged();
+}
+
+void BtUtils::_trackLocationsChanged() {
+  if (!_resumeFileDirty && _resumeFileInterval > 0)
+    _setTimer(TIMER_RESUME_FILE, _resumeFileSaveTime + (unsigned long)_resumeFileInterval * 1000);
+  _resumeFileDirty = true;
+}
+
+void BtUtils::_saveTrackLocation(bool startOver) {
+  int track = _lastTrackPlayed;
+  if (_resumeMode != RESUME_EACH_TRACK || track < 0 || track >= NUM_PINS)
+    return;
+  uint32_t location = startOver ? 0 : getCurrentTrackLocation();
+  if (location == _savedTrackLocation[track] && location == 0)
+    return;
+  _savedTrackLocation[track] = location;
+  _savedTrackTime[track] = (uint16_t)(millis() / 1000);
+  _trackLocationsChanged();
+}
+
+uint32_t BtUtils::getSavedTrackLocation(int trackNumber) {
+
+  // Where the track was left, or zero if it should start over because it
+  // was left longer ago than startOverAfterNoTouchTime(). (The time is
+  // kept in seconds in 16 bits, so it wraps around after about 18 hours.)
+
+  if (trackNumber < 0 || trackNumber >= NUM_PINS)
+    return 0;
+  uint16_t elapsedSeconds = (uint16_t)(millis() / 1000) - _savedTrackTime[trackNumber];
+  if ((unsigned long)elapsedSeconds * 1000 >= _startOverIfIdleTime)
+    return 0;
+  return _savedTrackLocation[trackNumber];
+}
+
+void BtUtils::resumeOrStartTrack(int trackNumber) {
+
+  // What to do when a visitor touches a pin: resume the track if it was
+  // paused (or left part way, with RESUME_EACH_TRACK), else start it.
+
+  int status = getPlayerStatus();
+  if (_resumeMode != RESUME_NONE && trackNumber == _lastTrackPlayed && status == IS_PAUSED) {
+    resumeTrack();
+    return;
+  }
+  uint32_t location = 0;
+  if (_resumeMode == RESUME_EACH_TRACK)
+    location = getSavedTrackLocation(trackNumber);
+  startTrack(trackNumber, location);
+}
+
+void BtUtils::saveTrackLocationsToSD(int intervalSeconds) {
+
+  // Keeps the saved locations in a file on the SD card, so they survive
+  // the power being turned off. The file is read now, and written at most
+  // once every intervalSeconds, and only if something changed, so that
+  // the card isn't worn out by a write on every pause.
+
+  _resumeFileInterval = (intervalSeconds > 0) ? intervalSeconds : 0;
+  if (_resumeFileInterval == 0) {
+    _cancelTimer(TIMER_RESUME_FILE);
+    return;
+  }
+  _readTrackLocationsFile();
+  _resumeFileDirty = false;
+  _resumeFileSaveTime = millis();
+}
+
+void BtUtils::_readTrackLocationsFile() {
+  SdFile file;
+  if (!file.open(RESUME_FILE_NAME, O_READ))
+    return;			// no file yet: nothing saved
+  uint8_t header[sizeof(resumeFileHeader)];
+  uint32_t locations[NUM_PINS];
+  if (file.read(header, sizeof(header)) == sizeof(header)
+      && memcmp(header, resumeFileHeader, sizeof(header)) == 0
+      && file.read(locations, sizeof(locations)) == sizeof(locations)) {
+    uint16_t now = (uint16_t)(millis() / 1000);
+    for (int i = 0; i < NUM_PINS; i++) {
+      _savedTrackLocation[i] = locations[i];
+      _savedTrackTime[i] = now;
+    }
+    LOG_INFO("read saved track locations from ", 0);
+  } else {
+    LOG_ERROR("bad resume file, ignored: ", 0);
+  }
+  file.close();
+}
+
+void BtUtils::_writeTrackLocationsFile() {
+
+  // The MP3 player reads the SD card from an interrupt while it plays, so
+  // that has to be held off while the file is written. The file is
+  // rewritten in place rather than truncated, so it keeps the same spot
+  // on the card.
+
+  bool streaming = (_MP3player->getState() == playback);
+  if (streaming)
+    _MP3player->pauseDataStream();
+  STATS_BEGIN(start);
+  SdFile file;
+  if (file.open(RESUME_FILE_NAME, O_WRITE | O_CREAT)) {
+    file.write(resumeFileHeader, sizeof(resumeFileHeader));
+    file.write(_savedTrackLocation, sizeof(_savedTrackLocation));
+    file.close();
+  } else {
+    LOG_ERROR("can't write resume file, error ", 0);
+  }
+  STATS_END(STAT_SD_CARD, start);
+  if (streaming)
+    _MP3player->resumeDataStream();
+}
+
+void BtUtils::_checkpointTrackLocations() {
+  if (_resumeFileInterval == 0 || !_resumeFileDirty)
+    return;
+  _writeTrackLocationsFile();
+  _resumeFileDirty = false;
+  _resumeFileSaveTime = millis();
+}
+
+#endif
+
+#if BTUTILS_ENABLE_START_AFTER_DELAY
 void BtUtils::setStartDelay(int milliseconds) {
   _startDelay = milliseconds;
+  if (_playerStatus == IS_WAITING && _startDelay > 0)
+    _setTimer(TIMER_START_DELAY, _lastStartTime + _startDelay);
 }
 
-#if BTUTILS_ENABLE_START_AFTER_DELAY
 void BtUtils::_startTrackIfStartDelayReached() {
   if (_playerStatus != IS_WAITING || _startDelay <= 0) {
     return;
@@ -565,21 +2130,174 @@ void BtUtils::_startTrackIfStartDelayReached() {
   if (elapsedTime < _startDelay) {
     return;
   }
-  LOG_ACTION("wait time (milliseconds) completed: ", _startDelay);
+  LOG_INFO("wait time (milliseconds) completed: ", _startDelay);
   startTrack(_lastTrackPlayed);
 }
 #endif
 
-void BtUtils::doTimerTasks() {
+/*----------------------------------------------------------------------
+ * Timers. Anything that has to happen later (a delayed start, the next
+ * step of a fade, a held-back volume change, ...) sets a timer, and
+ * doTimerTasks() runs it when it's due. Each timer is either set or not;
+ * setting it again just moves it.
+ ----------------------------------------------------------------------*/
 
-  // Every time through the loop, see if it's time to increase/decrease the volume
-  // or to start a time-delayed track
+void BtUtils::_cancelTimer(uint8_t timer) {
+  for (uint8_t i = 0; i < _timerCount; i++) {
+    if (_timerQueue[i] == timer) {
+      _timerCount--;
+      for (; i < _timerCount; i++)
+	_timerQueue[i] = _timerQueue[i + 1];
+      return;
+    }
+  }
+}
 
+void BtUtils::_setTimer(uint8_t timer, unsigned long due) {
+  _cancelTimer(timer);
+  _timerDue[timer] = due;
+  uint8_t i = _timerCount;
+  while (i > 0 && (long)(due - _timerDue[_timerQueue[i - 1]]) < 0) {
+    _timerQueue[i] = _timerQueue[i - 1];
+    i--;
+  }
+  _timerQueue[i] = timer;
+  _timerCount++;
+}
+
+void BtUtils::_runTimer(uint8_t timer) {
+  switch (timer) {
 #if BTUTILS_ENABLE_START_AFTER_DELAY
-  _startTrackIfStartDelayReached();
+  case TIMER_START_DELAY:
+    _startTrackIfStartDelayReached();
+    break;
+#endif
+  case TIMER_SEEK:
+    _doPendingSeek();
+    break;
+#if BTUTILS_ENABLE_FADES
+  case TIMER_FADE: {
+    STATS_BEGIN(start);
+    _doVolumeFadeInAndOut();
+    STATS_END(STAT_FADE, start);
+    break;
+  }
+#endif
+  case TIMER_VOLUME:
+    if (_volumeWritePending)
+      _writeVolume(false);
+    break;
+#if BTUTILS_ENABLE_RESUME
+  case TIMER_RESUME_FILE:
+    _checkpointTrackLocations();
+    break;
+#endif
+#if BTUTILS_ENABLE_CALIBRATION
+  case TIMER_CALIBRATE:
+    _recalibrate();
+    break;
+#endif
+  }
+}
+
+long BtUtils::nextDeadline() {
+
+  // How long (in milliseconds) until doTimerTasks() has something to do:
+  // zero if it has something to do now, -1 if nothing is waiting at all.
+
+  if (_timerCount == 0)
+    return -1;
+  long wait = (long)(_timerDue[_timerQueue[0]] - millis());
+  return (wait > 0) ? wait : 0;
+}
+
+#if BTUTILS_ENABLE_IDLE
+
+/*----------------------------------------------------------------------
+ * Idle: sleep while nothing is playing and nothing is due
+ ----------------------------------------------------------------------*/
+
+// Sets every MPR121's sample period. That stops and restarts it, and a
+// restart normally takes a fresh baseline from the first readings, so a
+// pin that's being touched would read as let go from then on. With the
+// ECR's calibration lock bits at 00 it keeps the baseline it has instead
+// (baseline tracking carries on as usual), so this can be done any time.
+static void setSamplePeriods(mpr121_sample_interval_type period) {
+  for (uint8_t s = 0; s < BTUTILS_NUM_SENSORS; s++) {
+    MPR121_type *sensor = touchSensor(s);
+    uint8_t ecr = sensor->getRegister(MPR121_ECR);
+    if (ecr & 0xC0)
+      sensor->setRegister(MPR121_ECR, ecr & 0x3F);
+    sensor->setSamplePeriod(period);
+  }
+}
+
+void BtUtils::idle(unsigned int maxMilliseconds) {
+
+  // Call this at the end of the loop. If a track is playing, or a fade or
+  // a delayed start is going on, it returns at once. Otherwise the
+  // processor sleeps until the MPR121 reports a touch or release, the
+  // next timer is due, or maxMilliseconds have gone by. It is woken by
+  // every millis() tick to check, since the MPR121's IRQ line on the
+  // Touch Board can't raise an interrupt.
+  //
+  // After BTUTILS_IDLE_SLOW_TOUCH milliseconds of this, the MPR121 is also
+  // slowed down, and it's back to full speed as soon as anything happens:
+  // a pin touched, or a track playing.
+
+  unsigned long start = millis();
+  int status = getPlayerStatus();
+  bool busy = (status == IS_PLAYING || status == IS_WAITING || _isFading() || _seekState == SEEK_WAITING);
+  if (busy || _touchedPins != 0) {
+    _idleSince = start;
+    if (_touchSampleSlow) {
+      setSamplePeriods(SAMPLE_INTERVAL_1MS);
+      _touchSampleSlow = false;
+    }
+    if (busy)
+      return;
+  } else if (!_touchSampleSlow && start - _idleSince >= BTUTILS_IDLE_SLOW_TOUCH) {
+    setSamplePeriods(BTUTILS_IDLE_SAMPLE_PERIOD);
+    _touchSampleSlow = true;
+  }
+
+  long wait = nextDeadline();
+  if (wait >= 0 && wait < (long)maxMilliseconds)
+    maxMilliseconds = wait;
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  while (millis() - start < maxMilliseconds && !_touchIrqPending && !touchSensorsChanged())
+    sleep_mode();
+  _timeAsleep += millis() - start;
+}
+
+unsigned long BtUtils::getTimeAsleep() {
+
+  // How long idle() has slept altogether, in milliseconds; compared to
+  // millis(), this is how much of the time the processor has been resting.
+
+  return _timeAsleep;
+}
+
 #endif
-  
-#ifdef BTUTILS_ENABLE_FADES
-  _doVolumeFadeInAndOut();
+
+void BtUtils::doTimerTasks() {
+
+  // Call this every time through the loop. It runs whatever timers are
+  // due (a timer can set itself again for later, e.g. the next step of a
+  // fade), which usually is nothing.
+
+#if BTUTILS_ENABLE_STATS
+  BtStats::loop();
+#endif
+
+  unsigned long now = millis();
+  while (_timerCount > 0 && (long)(now - _timerDue[_timerQueue[0]]) >= 0) {
+    uint8_t timer = _timerQueue[0];
+    _cancelTimer(timer);
+    _runTimer(timer);
+  }
+
+#if BTUTILS_LOG_LEVEL > BTUTILS_LOG_NONE
+  BtLog::drain();
 #endif
 }
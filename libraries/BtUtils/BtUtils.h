@@ -36,10 +36,53 @@
 // mp3 includes
 #include <SFEMP3Shield.h>
 
+// Touch sensors. The TouchBoard's own MPR121 has pins 0 to 11. Up to three
+// more MPR121 boards can share its I2C bus; set BTUTILS_NUM_SENSORS to the
+// total, and each one adds 12 pins (the second is pins 12 to 23, and so
+// on). Each MPR121's address is set by its ADDR pin, and its IRQ line goes
+// to its own input pin (lines can be shared, at the cost of reading every
+// sensor on that line when any of them changes).
+
+#ifndef BTUTILS_NUM_SENSORS
+#define BTUTILS_NUM_SENSORS 1
+#endif
+#define BTUTILS_MAX_SENSORS 4
+#if BTUTILS_NUM_SENSORS < 1 || BTUTILS_NUM_SENSORS > BTUTILS_MAX_SENSORS
+#error "BTUTILS_NUM_SENSORS must be 1 to 4"
+#endif
+#ifndef BTUTILS_SENSOR_ADDRESSES
+#define BTUTILS_SENSOR_ADDRESSES { MPR121_ADDR, 0x5A, 0x5B, 0x5D }
+#endif
+#ifndef BTUTILS_SENSOR_INT_PINS
+#define BTUTILS_SENSOR_INT_PINS { MPR121_INT, A0, A1, A2 }
+#endif
+
+// The I2C bus speed. The MPR121 can go at 400 kHz, which reads its data in
+// a quarter of the time that the Arduino's default 100 kHz takes.
+#ifndef BTUTILS_I2C_CLOCK
+#define BTUTILS_I2C_CLOCK 400000L
+#endif
+
+// Proximity data is read from the MPR121s at most this often
+// (milliseconds); asking again sooner gets the same readings.
+#define BTUTILS_SENSOR_READ_INTERVAL 4
+
 // TouchBoard definitions
+#define PINS_PER_SENSOR 12
 #define FIRST_PIN  0
-#define LAST_PIN  11
-#define NUM_PINS  12
+#define NUM_PINS  (PINS_PER_SENSOR * BTUTILS_NUM_SENSORS)
+#define LAST_PIN  (NUM_PINS - 1)
+
+// A set of pins, bit N for pin N (see getTouchedPins()); as small as the
+// number of pins allows.
+#if NUM_PINS <= 16
+typedef uint16_t PinSet;
+#elif NUM_PINS <= 32
+typedef uint32_t PinSet;
+#else
+typedef uint64_t PinSet;
+#endif
+#define PIN_BIT(pin) ((PinSet)1 << (pin))
 
 // Music playback state
 #define IS_STOPPED 0
@@ -52,23 +95,213 @@
 #define NEW_TOUCH 1
 #define NEW_RELEASE 2
 
+// Resume modes (see setResumeMode())
+#define RESUME_NONE       0
+#define RESUME_SINGLE     1
+#define RESUME_EACH_TRACK 2
+
+// Fade curves (see setFadeCurve())
+#define FADE_CURVE_LINEAR      0
+#define FADE_CURVE_EXPONENTIAL 1
+#define FADE_CURVE_S_CURVE     2
+#define FADE_CURVE_EQUAL_POWER 3
+
+// Proximity smoothing filters (see setProximityFilter())
+#define PROXIMITY_FILTER_NONE     0
+#define PROXIMITY_FILTER_IIR      1
+#define PROXIMITY_FILTER_MEDIAN   2
+#define PROXIMITY_FILTER_ADAPTIVE 3
+#define ALL_PINS -1
+
+// Number of readings the median proximity filter looks at
+#define BTUTILS_PROXIMITY_MEDIAN_SIZE 3
+
+// Touch events queued for pollTouchEvent() (must be a power of two)
+#define BTUTILS_TOUCH_QUEUE_SIZE 8
+
+
+// Logging. BTUTILS_LOG_LEVEL selects which messages are compiled in;
+// anything above the level compiles to nothing at all.
+//
+//   BTUTILS_LOG_NONE  - no logging (no Serial output, no RAM used)
+//   BTUTILS_LOG_ERROR - setup failures
+//   BTUTILS_LOG_INFO  - track start/stop/pause/resume and settings
+//   BTUTILS_LOG_DEBUG - every touch change and volume step
+//
+// Messages are not printed when they are logged. They go into a small ring
+// buffer and are printed from doTimerTasks(), and only as much as the Serial
+// transmit buffer can take without waiting. If the ring buffer fills up, new
+// messages are thrown away and counted, and the count is printed later.
+
+#define BTUTILS_LOG_NONE  0
+#define BTUTILS_LOG_ERROR 1
+#define BTUTILS_LOG_INFO  2
+#define BTUTILS_LOG_DEBUG 3
 
-// Debugging: enable/disable logging
 // #define DEBUG 1
+#ifndef BTUTILS_LOG_LEVEL
 #ifdef DEBUG
-#define LOG_ACTION _log_action
-#define SERIAL_PRINT(x) Serial.print(x)
-#define SERIAL_PRINTLN(x) Serial.println(x)
+#define BTUTILS_LOG_LEVEL BTUTILS_LOG_DEBUG
 #else
-#define LOG_ACTION(A,B)
-#define SERIAL_PRINT(x)
-#define SERIAL_PRINTLN(x)
+#define BTUTILS_LOG_LEVEL BTUTILS_LOG_NONE
 #endif
+#endif
+
+// Number of messages the ring buffer holds (must be a power of two)
+#define BTUTILS_LOG_QUEUE_SIZE 16
 
-// Disable certain unneeded features to save space
+#if BTUTILS_LOG_LEVEL >= BTUTILS_LOG_ERROR
+#define LOG_ERROR(msg, value) BtLog::log(F(msg), (value))
+#else
+#define LOG_ERROR(msg, value) do {} while (0)
+#endif
+#if BTUTILS_LOG_LEVEL >= BTUTILS_LOG_INFO
+#define LOG_INFO(msg, value) BtLog::log(F(msg), (value))
+#else
+#define LOG_INFO(msg, value) do {} while (0)
+#endif
+#if BTUTILS_LOG_LEVEL >= BTUTILS_LOG_DEBUG
+#define LOG_DEBUG(msg, value) BtLog::log(F(msg), (value))
+#else
+#define LOG_DEBUG(msg, value) do {} while (0)
+#endif
 
+#if BTUTILS_LOG_LEVEL > BTUTILS_LOG_NONE
+class BtLog
+{
+ public:
+  static void log(const __FlashStringHelper *msg, int value);
+  static void log(const char *msg, int value);
+  static void drain();
+  static unsigned int getDroppedCount();
+
+ private:
+  struct Entry {
+    const char *msg;
+    int value;
+    bool inFlash;
+  };
+  static Entry _queue[BTUTILS_LOG_QUEUE_SIZE];
+  static uint8_t _head;
+  static uint8_t _tail;
+  static unsigned int _dropped;
+  static unsigned int _droppedTotal;
+
+  static void _put(const char *msg, int value, bool inFlash);
+};
+#endif
+
+
+// Timing statistics. With BTUTILS_ENABLE_STATS set to 1, BtUtils times the
+// loop (from one doTimerTasks() call to the next), the slow things it does
+// (touch and proximity reads over I2C, fade steps, calls to the MP3 player,
+// SD card files), how long the MP3 player takes to start a track, and how
+// long it takes from a touch being read to the track starting.
+// BtStats::print() prints them all. With it set to 0 (the default), none
+// of this is compiled in at all.
+
+#ifndef BTUTILS_ENABLE_STATS
+#define BTUTILS_ENABLE_STATS 0
+#endif
+
+#define STAT_TOUCH_SCAN     0
+#define STAT_PROXIMITY_SCAN 1
+#define STAT_FADE           2
+#define STAT_PLAYER         3
+#define STAT_SD_CARD        4
+#define STAT_TOUCH_TO_PLAY  5
+#define STAT_TRACK_START    6
+#define STAT_COUNT          7
+
+// Loop periods are counted in BTUTILS_STATS_BUCKETS buckets: under 1 ms,
+// under 2 ms, under 4 ms, ... and the last one for everything longer.
+#define BTUTILS_STATS_BUCKETS 8
+
+#if BTUTILS_ENABLE_STATS
+class BtStats
+{
+ public:
+  static void record(uint8_t which, unsigned long micros);
+  static void loop();
+  static void touched();
+  static void playing();
+  static void print();
+  static void reset();
+
+ private:
+  struct Timing {
+    unsigned long total;	// microseconds
+    unsigned long max;
+    unsigned int count;
+  };
+  static Timing _timing[STAT_COUNT];
+  static Timing _loop;
+  static unsigned long _loopStart;
+  static unsigned long _loopMin;
+  static unsigned int _loopHistogram[BTUTILS_STATS_BUCKETS];
+  static unsigned long _touchTime;
+
+  static void _add(Timing *t, unsigned long micros);
+  static void _printTiming(const __FlashStringHelper *name, Timing *t);
+};
+#endif
+
+// Disable certain unneeded features to save space: change a 1 to 0 here,
+// or set it from the compiler's command line (-DBTUTILS_ENABLE_FADES=0).
+// A feature that is turned off takes no flash and no RAM at all; its
+// functions aren't there either, so a sketch that uses one won't compile.
+// The ones after RESUME are newer, and are off unless a sketch needs
+// them, so that older sketches still fit: change the 0 to 1 to use one.
+// "make sizes" in extras/host shows what each one costs.
+
+#ifndef BTUTILS_ENABLE_FADES
 #define BTUTILS_ENABLE_FADES 1
+#endif
+#ifndef BTUTILS_ENABLE_START_AFTER_DELAY
 #define BTUTILS_ENABLE_START_AFTER_DELAY 1
+#endif
+#ifndef BTUTILS_ENABLE_PROXIMITY
+#define BTUTILS_ENABLE_PROXIMITY 1
+#endif
+#ifndef BTUTILS_ENABLE_RESUME
+#define BTUTILS_ENABLE_RESUME 1
+#endif
+#ifndef BTUTILS_ENABLE_TOUCH_EVENTS
+#define BTUTILS_ENABLE_TOUCH_EVENTS 0
+#endif
+#ifndef BTUTILS_ENABLE_TRACK_CATALOG
+#define BTUTILS_ENABLE_TRACK_CATALOG 0
+#endif
+#ifndef BTUTILS_ENABLE_IDLE
+#define BTUTILS_ENABLE_IDLE 0
+#endif
+#ifndef BTUTILS_ENABLE_CALIBRATION
+#define BTUTILS_ENABLE_CALIBRATION 0
+#endif
+
+// idle(): the longest it sleeps, and how long nothing has to happen before
+// the MPR121 is slowed down to this sample period
+#define BTUTILS_IDLE_MAX_SLEEP     250
+#define BTUTILS_IDLE_SLOW_TOUCH    10000
+#define BTUTILS_IDLE_SAMPLE_PERIOD SAMPLE_INTERVAL_32MS
+
+// MIDI mode (see startMidiMode()): the touch pins play notes on the VS1053's
+// own MIDI synthesizer instead of MP3 tracks. This needs the TouchBoard's
+// MIDI solder jumpers closed, which starts the VS1053 as a synthesizer and
+// connects its MIDI input to BTUTILS_MIDI_TX_PIN, so it's off by default.
+
+#ifndef BTUTILS_ENABLE_MIDI
+#define BTUTILS_ENABLE_MIDI 0
+#endif
+#define BTUTILS_MIDI_TX_PIN    10	// to the VS1053's MIDI input
+#define BTUTILS_MIDI_RESET_PIN 8	// the VS1053's reset line
+#define BTUTILS_MIDI_VELOCITY  100	// when not following proximity
+
+// How many timers doTimerTasks() looks after (see TIMER_xxx in BtUtils.cpp)
+#define BTUTILS_NUM_TIMERS 6
+
+// How many tracks (track000.mp3 and up) the catalog knows about
+#define BTUTILS_TRACK_CATALOG_SIZE NUM_PINS
 
 class BtUtils
 {
@@ -79,14 +312,38 @@ class BtUtils
   static void turnLedOn();
   static void turnLedOff();
   void doTimerTasks();
+  long nextDeadline();
+#if BTUTILS_ENABLE_IDLE
+  void idle(unsigned int maxMilliseconds = BTUTILS_IDLE_MAX_SLEEP);
+  unsigned long getTimeAsleep();
+#endif
 
   int  getPinTouchStatus(int *whichPinChanged);
+  bool updateTouchState();
+  PinSet getTouchedPins();
+  PinSet getNewTouches();
+  PinSet getNewReleases();
+  bool isPinTouched(int pinNumber);
+  static int takeLowestPin(PinSet *pinSet);
   void setTouchReleaseThreshold(int touchThreshold, int releaseThreshold);
+#if BTUTILS_ENABLE_CALIBRATION
+  void autoCalibrate(int recalibrateMinutes = 0);
+#endif
+#if BTUTILS_ENABLE_TOUCH_EVENTS
+  int  pollTouchEvent(int *whichPinChanged, unsigned long *eventTime = 0);
+#endif
 
   void setVolume(int percent);
   void setVolume(int leftPercent, int rightPercent);
+  void setVolumeUpdateInterval(int milliseconds);
+#if BTUTILS_ENABLE_FADES
   void setFadeInTime(int milliseconds);
   void setFadeOutTime(int milliseconds);
+  void setSwitchFadeTime(int milliseconds);
+  void setFadeCurve(int curve);
+  void fadeToVolume(int percent, int milliseconds);
+  void fadeToVolume(int leftPercent, int rightPercent, int milliseconds);
+#endif
 
   int  getPlayerStatus();
   int  getLastTrackPlayed();
@@ -99,14 +356,44 @@ class BtUtils
 
   void startOverAfterNoTouchTime(int seconds);
 
+#if BTUTILS_ENABLE_RESUME
+  void setResumeMode(int mode);
+  void resumeOrStartTrack(int trackNumber);
+  uint32_t getSavedTrackLocation(int trackNumber);
+  void forgetSavedTrackLocations();
+  void saveTrackLocationsToSD(int intervalSeconds);
+#endif
+
+#if BTUTILS_ENABLE_TRACK_CATALOG
+  bool trackExists(int trackNumber);
+  uint32_t getTrackLength(int trackNumber);
+#endif
+
+#if BTUTILS_ENABLE_START_AFTER_DELAY
   void setStartDelay(int milliseconds);
   void queueTrackToStartAfterDelay(int trackNumber);
+#endif
 
+#if BTUTILS_ENABLE_PROXIMITY
   void setProximitySensingMode();
   int getProximityPercent(int pinNumber);
+  int scanProximity(int *proximity, int *closestPin);
   int setProximityMultiplier(float multiplier);
+  void setProximityFilter(int filterType, int strength, int pinNumber = ALL_PINS);
+  int  getProximityPinStatus(int *whichPin, int *proximity = 0);
+  void setProximitySwitching(int margin, int dwellMilliseconds, bool lockOn = false);
+#endif
 
-#ifdef DEBUG
+#if BTUTILS_ENABLE_MIDI
+  void startMidiMode(int instrument = 1);
+  void setMidiInstrument(int instrument, int channel = 1);
+  void setPinNote(int pinNumber, int note, int channel = 1);
+  void setMidiVelocity(int velocity);
+  void playMidiNotes();
+  void stopMidiNotes();
+#endif
+
+#if BTUTILS_LOG_LEVEL > BTUTILS_LOG_NONE
   static void _log_action(const char *msg, int track);
 #endif
 
@@ -117,34 +404,233 @@ class BtUtils
   int _lastTrackPlayed;
   unsigned long _lastStartTime;
   unsigned long _lastStopTime;
+#if BTUTILS_ENABLE_START_AFTER_DELAY
   unsigned long _startDelay;
+#endif
   unsigned long _lastActionTime;
   unsigned long _startOverIfIdleTime;
 
   // Volume control
-  int _targetVolume;
-  int _actualVolume;
+  int _targetVolumeLeft;
+  int _targetVolumeRight;
+  int _actualVolumeLeft;
+  int _actualVolumeRight;
+  uint8_t _volumeByteLeft;	// last values written to the MP3 player
+  uint8_t _volumeByteRight;
+  unsigned int _volumeWriteInterval;
+  unsigned long _lastVolumeWriteTime;
+  bool _volumeWritePending;
+
+#if BTUTILS_ENABLE_FADES
   int _fadeInTime;
   int _fadeOutTime;
-  int _thisFadeInTime;
-  int _thisFadeOutTime;
+  int _switchFadeTime;
+
+  // The fade in progress, if any: volume goes from "from" to "to" along
+  // the chosen curve, then the player is paused or stopped if requested.
+  struct Fade {
+    bool active;
+    uint8_t curve;
+    uint8_t endAction;
+    int fromLeft;
+    int fromRight;
+    int toLeft;
+    int toRight;
+    unsigned long startTime;
+    unsigned int duration;
+  };
+  Fade _fade;
+  uint8_t _fadeCurve;
+
+  // A track to start once the fade-out of the one playing is done (or -1),
+  // and where in it to start
+  int _switchTrack;
+  uint32_t _switchLocation;
+
+  int  _scaledFadeTime(int fullFadeTime, int toLeft, int toRight);
+  void _startFade(int toLeft, int toRight, int milliseconds, uint8_t endAction);
+  void _finishFade();
+  void _doVolumeFadeInAndOut();
+#endif
+  void _cancelFade();
+  bool _isFading();
+
+  // Seeking: startTrack() with a location starts the track silently, and
+  // doTimerTasks() skips to the location once the decoder is ready.
+  // skipTo() sets the decoder's time to the location, so its position is
+  // from the start of the track afterwards too.
+  uint8_t _seekState;
+  uint32_t _seekLocation;
+  unsigned long _seekStartTime;
 
-  // Touch pins: what was the last one touched?
+#if BTUTILS_ENABLE_RESUME
+  // Where each track was paused or left, and when (in seconds, from
+  // millis()/1000), for resumeOrStartTrack(). Optionally copied to a file
+  // on the SD card every _resumeFileInterval seconds, if anything changed.
+  uint8_t _resumeMode;
+  uint32_t _savedTrackLocation[NUM_PINS];
+  uint16_t _savedTrackTime[NUM_PINS];
+  unsigned int _resumeFileInterval;
+  unsigned long _resumeFileSaveTime;
+  bool _resumeFileDirty;
+
+  void _saveTrackLocation(bool startOver);
+  void _readTrackLocationsFile();
+  void _writeTrackLocationsFile();
+  void _checkpointTrackLocations();
+  void _trackLocationsChanged();
+#endif
+
+#if BTUTILS_ENABLE_TRACK_CATALOG
+  // What's on the SD card, found once by setup() so that starting a
+  // missing track doesn't go looking for it. A track that is there is
+  // still opened by name: SFEMP3Shield opens its own file in playTrack().
+  struct TrackInfo {
+    uint32_t audioStart;	// bytes of ID3 tag before the first frame
+    uint32_t size;		// whole file, in bytes; 0 if not on the card
+    uint16_t kbps;		// bit rate of the first frame; 0 if unknown
+  };
+  TrackInfo _trackCatalog[BTUTILS_TRACK_CATALOG_SIZE];
+  bool _catalogBuilt;
+
+  void _buildTrackCatalog();
+  static void _readTrackInfo(SdFile *file, TrackInfo *info);
+#endif
+
+  // Touch thresholds as set by setTouchReleaseThreshold(); auto-calibration
+  // raises them for pins that are too noisy for these.
+  uint8_t _touchThreshold;
+  uint8_t _releaseThreshold;
+
+#if BTUTILS_ENABLE_CALIBRATION
+  // Auto-calibration: the noise measured on each pin (the biggest
+  // difference between baseline and reading while nothing is near), how
+  // many readings of the current measurement are done, and how often to
+  // measure again.
+  uint8_t _pinNoise[NUM_PINS];
+  uint8_t _calibrationSamples;
+  bool _calibrated;
+  unsigned long _recalibrateInterval;
+
+  void _startCalibration();
+  bool _takeCalibrationSample();
+  void _applyCalibration();
+  void _recalibrate();
+#endif
+
+#if BTUTILS_ENABLE_MIDI
+  // MIDI mode: each pin's note and channel (0-15), the pins whose notes
+  // are sounding, and the velocity to play them with (0: from proximity).
+  bool _midiMode;
+  uint8_t _midiNote[NUM_PINS];
+  uint8_t _midiChannel[NUM_PINS];
+  PinSet _midiNotesOn;
+  uint8_t _midiVelocity;
+
+  void _midiMessage(uint8_t command, uint8_t data1, uint8_t data2 = 0);
+  uint8_t _midiNoteVelocity(int pinNumber);
+#endif
+
+  // Touch pins: what was the last one touched? (for getPinTouchStatus())
   int _lastPinTouched;
 
-  // Proximity detection and smoothing
-  float _lastProximity;
-  float _proximityMultiplier;
+  // Touch state of all pins: bit N of each mask is pin N
+  PinSet _touchedPins;			// touched as of the last read
+  PinSet _newTouches;			// reported by updateTouchState()
+  PinSet _newReleases;
+  PinSet _unreportedTouches;		// since the last updateTouchState()
+  PinSet _unreportedReleases;
+  unsigned long _touchStateTime;	// millis() of the last read
+  bool _touchStateUnseen;		// changed by a proximity read
+  static volatile bool _touchIrqPending;
+
+  static void _touchIrq();
+  bool _readTouchState();
+  void _setTouchedPins(PinSet touchedPins);
+
+#if BTUTILS_ENABLE_TOUCH_EVENTS
+  // Touch events: a queue of touches and releases, filled by
+  // _queueTouchEvents() whenever the touch state is read, and emptied by
+  // pollTouchEvent(). Only the producer moves _touchQueueHead, only the
+  // consumer moves _touchQueueTail.
+  struct TouchEvent {
+    uint8_t pin;
+    uint8_t status;
+    unsigned long time;
+  };
+  TouchEvent _touchQueue[BTUTILS_TOUCH_QUEUE_SIZE];
+  volatile uint8_t _touchQueueHead;
+  volatile uint8_t _touchQueueTail;
+  PinSet _touchEventPins;		// bit N set: pin N touched as of the last event
+
+  void _queueTouchEvents();
+#endif
+
+#if BTUTILS_ENABLE_PROXIMITY
+  // Proximity detection and smoothing. Each pin has its own filter so
+  // that scanning all pins doesn't smooth one pin with another's readings.
+  // Values are fixed-point with 8 fraction bits (256 is 1.0).
+  struct ProximityFilter {
+    uint8_t type;
+    uint8_t weight;		// smoothing: 0 (none) to 255 (nearly frozen)
+    int16_t value;		// filtered reading
+    int16_t speed;		// adaptive filter: smoothed size of recent changes
+    uint8_t history[BTUTILS_PROXIMITY_MEDIAN_SIZE];	// median filter: recent readings
+    uint8_t historyPos;
+    uint8_t low;		// readings up to this are noise (see autoCalibrate())
+  };
+  ProximityFilter _proximityFilter[NUM_PINS];
+  uint16_t _proximityMultiplier;
+
+  // The last proximity reading of every pin, and when it was taken
+  int _proximity[NUM_PINS];
+  unsigned long _sensorDataTime;
+
+  // Which pin the hand is over, for getProximityPinStatus(): the active
+  // pin (or -1), and another pin that has been closer since
+  // _challengerSince (or -1). See setProximitySwitching().
+  int8_t _proximityPin;
+  int8_t _proximityChallenger;
+  unsigned long _challengerSince;
+  uint8_t _switchMargin;
+  unsigned int _switchDwell;
+  bool _switchLockOn;
+
+  void _readSensorData();
+  int  _calculateProximity(int pinNumber);
+  int16_t _filterProximity(ProximityFilter *f, uint8_t reading);
+#endif
 
   SdFat *_sd;
   SFEMP3Shield *_MP3player;
 
+  // Timers for doTimerTasks(): when each one is due, and the ones that are
+  // set, soonest first, so doTimerTasks() only has to look at the first.
+  unsigned long _timerDue[BTUTILS_NUM_TIMERS];
+  uint8_t _timerQueue[BTUTILS_NUM_TIMERS];
+  uint8_t _timerCount;
+
+#if BTUTILS_ENABLE_IDLE
+  // idle(): when it last found something happening, whether the MPR121
+  // is sampling slowly, and how long (in milliseconds) it has slept
+  unsigned long _idleSince;
+  bool _touchSampleSlow;
+  unsigned long _timeAsleep;
+#endif
+
+  void _setTimer(uint8_t timer, unsigned long due);
+  void _cancelTimer(uint8_t timer);
+  void _runTimer(uint8_t timer);
+
   uint8_t _volumePctToByte(int percent);
   void _setVolume(int leftPercent, int rightPercent);
-  void _setActualVolume(int percent);
-  int  _calculateFadeTime(bool goingUp);
-  void _doVolumeFadeInAndOut();
+  void _setActualVolume(int leftPercent, int rightPercent, bool immediately = false);
+  void _writeVolume(bool immediately);
+#if BTUTILS_ENABLE_START_AFTER_DELAY
   void _startTrackIfStartDelayReached();
+#endif
+  void _doPendingSeek();
+  void _startVolumeAfterSeek();
 };
 
 #endif
@@ -0,0 +1,109 @@
+/* -*-C++-*-
+ * Power: a hold-to-play sketch with and without idle(), for a quiet and a
+ * busy day. For each, how much of the time the processor sleeps, how
+ * much of it the MPR121 samples slowly, how many samples it takes and
+ * I2C transfers there are per second (the MPR121's current goes with its
+ * sample rate), and what that costs in noticing a touch.
+ */
+
+#include "host.h"
+
+#define RUN_TIME   600000UL	// milliseconds: ten minutes of each
+#define HOLD       8000		// milliseconds a visitor holds a pin
+#define LOOP_REST  200		// microseconds the rest of the loop takes
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+struct Config {
+  const char *name;
+  bool idle;
+  unsigned long visitEvery;	// milliseconds between visitors
+};
+
+static const Config configs[] = {
+  { "busy loop, quiet day", false, 300000 },
+  { "busy loop, busy day", false, 30000 },
+  { "idle(), quiet day", true, 300000 },
+  { "idle(), busy day", true, 30000 },
+};
+
+static void runConfig(BtUtils *bt, const Config *config) {
+  unsigned long start = hostNow;
+  unsigned long asleep = bt->getTimeAsleep();
+  unsigned long slowUs = 0, touchTotal = 0, touchMax = 0, visits = 0;
+  hostResetCounters();
+
+  unsigned long touchedAt = 0;
+  bool waitingForTouch = false;
+  unsigned long nextVisit = millis() + config->visitEvery / 2;
+  unsigned long end = millis() + RUN_TIME;
+  while (millis() < end) {
+
+    // The visitor
+
+    if (millis() >= nextVisit) {
+      hostTouchPins(PIN_BIT(visits % 3));
+      touchedAt = hostNow;
+      waitingForTouch = true;
+      visits++;
+      nextVisit += config->visitEvery;
+    } else if (touchedAt && millis() >= touchedAt / 1000 + HOLD) {
+      hostTouchPins(0);
+      touchedAt = 0;
+    }
+
+    // The sketch: a touch starts the pin's track, a release stops it
+
+    unsigned long loopStart = hostNow;
+    int pin;
+    int status = bt->getPinTouchStatus(&pin);
+    if (status == NEW_TOUCH) {
+      if (waitingForTouch) {
+	unsigned long noticed = hostNow - touchedAt;
+	touchTotal += noticed;
+	if (noticed > touchMax)
+	  touchMax = noticed;
+	waitingForTouch = false;
+      }
+      bt->startTrack(pin);
+    } else if (status == NEW_RELEASE) {
+      bt->stopTrack();
+    }
+    bt->doTimerTasks();
+#if BTUTILS_ENABLE_IDLE
+    if (config->idle)
+      bt->idle();
+#endif
+    hostAdvance(LOOP_REST);
+    if (MPR121.samplePeriodMs() > 1)
+      slowUs += hostNow - loopStart;
+  }
+
+  double seconds = (hostNow - start) / 1e6;
+  unsigned long samples = MPR121.samples;
+  asleep = bt->getTimeAsleep() - asleep;
+  printf("  %-22s %7.1f %7.1f %10.0f %9.1f %8.1f %8.1f\n", config->name,
+	 asleep * 100.0 / (seconds * 1000), slowUs * 100.0 / (hostNow - start),
+	 samples / seconds, hostI2cTransfers() / seconds,
+	 visits ? touchTotal / 1000.0 / visits : 0.0, touchMax / 1000.0);
+  hostTouchPins(0);
+  bt->stopTrack();
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  printf("idle power report: %lu minutes each, visitors hold a pin for %d s\n",
+	 RUN_TIME / 60000, HOLD / 1000);
+  printf("  %-22s %7s %7s %10s %9s %8s %8s\n", "sketch, day", "asleep",
+	 "slow", "samples/s", "I2C/s", "touch ms", "max ms");
+  printf("  %-22s %7s %7s %10s %9s %8s %8s\n", "", "%", "%", "", "", "avg", "");
+  for (unsigned int i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+#if !BTUTILS_ENABLE_IDLE
+    if (configs[i].idle)
+      continue;
+#endif
+    runConfig(bt, &configs[i]);
+  }
+  return 0;
+}
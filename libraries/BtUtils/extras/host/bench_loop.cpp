@@ -0,0 +1,145 @@
+/* -*-C++-*-
+ * Loop latency: replays a visitor's touches, and a hand moving over the
+ * pins, through the loop of a touch sketch and a proximity sketch, and
+ * reports what each BtUtils call costs per call: the time it holds up
+ * the loop on the Touch Board (virtual time, which is mostly I2C and SD
+ * card transfers), its I2C traffic, and host CPU time.
+ */
+
+#include "host.h"
+
+#define RUN_TIME   20000	// milliseconds of each scenario
+#define LOOP_REST  200		// microseconds the rest of a sketch's loop takes
+
+// A visitor touching pins: holding one, letting go, coming back to it,
+// trying others, and a burst of quick taps.
+static const HostTraceEvent touchTrace[] = {
+  { 1000, 0, HOST_TOUCH_DELTA }, { 4000, 0, 0 },
+  { 5000, 0, HOST_TOUCH_DELTA }, { 6500, 0, 0 },
+  { 7000, 3, HOST_TOUCH_DELTA }, { 9000, 3, 0 },
+  { 10000, 5, HOST_TOUCH_DELTA }, { 10100, 5, 0 },
+  { 10300, 6, HOST_TOUCH_DELTA }, { 10400, 6, 0 },
+  { 10600, 7, HOST_TOUCH_DELTA }, { 10700, 7, 0 },
+  { 12000, 1, HOST_TOUCH_DELTA }, { 12500, 2, HOST_TOUCH_DELTA },
+  { 15000, 1, 0 }, { 16000, 2, 0 },
+};
+
+// A hand coming up to pin 1, drifting over to pin 2, and going away.
+static const HostTraceEvent proximityTrace[] = {
+  { 1000, 1, 5 }, { 1200, 1, 10 }, { 1400, 1, 20 }, { 1600, 1, 30 }, { 1800, 1, 40 },
+  { 5000, 1, 30 }, { 5000, 2, 10 }, { 5300, 1, 20 }, { 5300, 2, 25 },
+  { 5600, 1, 10 }, { 5600, 2, 40 }, { 5900, 1, 0 },
+  { 9000, 2, 30 }, { 9500, 2, 15 }, { 10000, 2, 5 }, { 10500, 2, 0 },
+  { 14000, 0, 45 }, { 17000, 0, 0 },
+};
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void touchSketch(BtUtils *bt) {
+
+  // Like sketch 7: a touch fades in the pin's track (resuming it if it
+  // was the one paused), a release fades it out and pauses it.
+
+  HostCallStats touch("getPinTouchStatus");
+  HostCallStats timers("doTimerTasks");
+  HostTrace trace;
+  hostTraceStart(&trace, touchTrace, sizeof(touchTrace) / sizeof(touchTrace[0]));
+  unsigned long end = millis() + RUN_TIME;
+  unsigned long loops = 0;
+  hostResetCounters();
+
+  while (millis() < end) {
+    hostTracePlay(&trace);
+    int pin;
+    hostCallBegin(&touch);
+    int status = bt->getPinTouchStatus(&pin);
+    hostCallEnd(&touch);
+    if (status == NEW_TOUCH) {
+      if (pin == bt->getLastTrackPlayed() && bt->getPlayerStatus() == IS_PAUSED)
+	bt->resumeTrack();
+      else
+	bt->startTrack(pin);
+    } else if (status == NEW_RELEASE) {
+      bt->pauseTrack();
+    }
+    hostCallBegin(&timers);
+    bt->doTimerTasks();
+    hostCallEnd(&timers);
+    hostAdvance(LOOP_REST);
+    loops++;
+  }
+
+  printf("touch sketch: %lu loops in %d ms\n", loops, RUN_TIME);
+  hostCallPrintHeader();
+  hostCallPrint(&touch);
+  hostCallPrint(&timers);
+}
+
+#if BTUTILS_ENABLE_PROXIMITY
+static void proximitySketch(BtUtils *bt) {
+
+  // Like sketch 8: the volume follows the hand over the first three pins,
+  // and the track plays while anything is near.
+
+  HostCallStats touch("getPinTouchStatus");
+  HostCallStats proximity("getProximityPercent");
+  HostCallStats timers("doTimerTasks");
+  HostTrace trace;
+  hostTraceStart(&trace, proximityTrace, sizeof(proximityTrace) / sizeof(proximityTrace[0]));
+  unsigned long end = millis() + RUN_TIME;
+  unsigned long loops = 0;
+  hostResetCounters();
+
+  while (millis() < end) {
+    hostTracePlay(&trace);
+    int pin;
+    hostCallBegin(&touch);
+    bt->getPinTouchStatus(&pin);
+    hostCallEnd(&touch);
+    int loudest = 0;
+    for (int p = 0; p < 3; p++) {
+      hostCallBegin(&proximity);
+      int percent = bt->getProximityPercent(p);
+      hostCallEnd(&proximity);
+      if (percent > loudest)
+	loudest = percent;
+    }
+    if (loudest > 0 && bt->getPlayerStatus() != IS_PLAYING)
+      bt->startTrack(0);
+    bt->setVolume(loudest);
+    hostCallBegin(&timers);
+    bt->doTimerTasks();
+    hostCallEnd(&timers);
+    hostAdvance(LOOP_REST);
+    loops++;
+  }
+
+  printf("proximity sketch: %lu loops in %d ms\n", loops, RUN_TIME);
+  hostCallPrintHeader();
+  hostCallPrint(&touch);
+  hostCallPrint(&proximity);
+  hostCallPrint(&timers);
+}
+#endif
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  printf("loop latency, %d sensor(s), I2C at %lu kHz; us are Touch Board time\n",
+	 BTUTILS_NUM_SENSORS, (unsigned long)Wire.clock / 1000);
+#if BTUTILS_ENABLE_FADES
+  bt->setFadeInTime(500);
+  bt->setFadeOutTime(500);
+#endif
+  touchSketch(bt);
+  bt->stopTrack();
+#if BTUTILS_ENABLE_PROXIMITY
+#if BTUTILS_ENABLE_FADES
+  bt->setFadeInTime(0);
+  bt->setFadeOutTime(0);
+#endif
+  bt->setProximitySensingMode();
+  proximitySketch(bt);
+#endif
+  return 0;
+}
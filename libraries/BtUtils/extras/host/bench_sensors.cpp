@@ -0,0 +1,70 @@
+/* -*-C++-*-
+ * Scan cost against the number of MPR121s: built once for each
+ * BTUTILS_NUM_SENSORS from 1 to 4, each build printing one row. A touch
+ * only reads the sensor whose IRQ line is low, so it should cost the
+ * same however many sensors there are; a proximity scan reads every
+ * sensor, so it should grow in step with them.
+ */
+
+#include "host.h"
+
+#define ROUNDS 100
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void touchAndRelease(BtUtils *bt, int pin, HostCallStats *s) {
+  int changed;
+  hostTouchPins(PIN_BIT(pin));
+  hostAdvance(20000);
+  hostCallBegin(s);
+  bt->getPinTouchStatus(&changed);
+  hostCallEnd(s);
+  hostTouchPins(0);
+  hostAdvance(20000);
+  hostCallBegin(s);
+  bt->getPinTouchStatus(&changed);
+  hostCallEnd(s);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  HostCallStats quiet("getPinTouchStatus");
+  HostCallStats firstTouch("first sensor's pin");
+  HostCallStats lastTouch("last sensor's pin");
+  HostCallStats scan("scanProximity");
+
+  for (int round = 0; round < ROUNDS; round++) {
+    int changed;
+    hostAdvance(1000);
+    hostCallBegin(&quiet);
+    bt->getPinTouchStatus(&changed);
+    hostCallEnd(&quiet);
+    touchAndRelease(bt, FIRST_PIN, &firstTouch);
+    touchAndRelease(bt, LAST_PIN, &lastTouch);
+  }
+#if BTUTILS_ENABLE_PROXIMITY
+  bt->setProximitySensingMode();
+  for (int round = 0; round < ROUNDS; round++) {
+    hostAdvance(BTUTILS_SENSOR_READ_INTERVAL * 1000UL);
+    hostCallBegin(&scan);
+    bt->scanProximity(NULL, NULL);
+    hostCallEnd(&scan);
+  }
+#endif
+
+  if (BTUTILS_NUM_SENSORS == 1) {
+    printf("scan cost by number of sensors, us of Touch Board time\n");
+    printf("  %7s %4s %9s %11s %11s %9s %9s %9s\n", "sensors", "pins",
+	   "no change", "touch 1st", "touch last", "prox scan", "I2C/scan", "B/scan");
+  }
+  printf("  %7d %4d %9.1f %11.1f %11.1f %9.1f %9.1f %9.1f\n",
+	 BTUTILS_NUM_SENSORS, NUM_PINS,
+	 quiet.totalUs / (double)quiet.calls,
+	 firstTouch.totalUs / (double)firstTouch.calls,
+	 lastTouch.totalUs / (double)lastTouch.calls,
+	 scan.calls ? scan.totalUs / (double)scan.calls : 0.0,
+	 scan.calls ? scan.transfers / (double)scan.calls : 0.0,
+	 scan.calls ? scan.bytes / (double)scan.calls : 0.0);
+  return 0;
+}
@@ -0,0 +1,96 @@
+/* -*-C++-*-
+ * Track start latency: how long from a touch to the first sound, and how
+ * much of that is the MP3 player starting the track (finding the file,
+ * reading through its ID3 tag, filling the decoder), for a few ways the
+ * SD card might be laid out. Built with BTUTILS_ENABLE_STATS, so the
+ * "track start" line BtStats prints on the Touch Board is shown too.
+ */
+
+#include "host.h"
+
+#define TOUCHES    20		// per layout, going round the first four pins
+#define HOLD       1500		// milliseconds each touch lasts
+#define LOOP_REST  200		// microseconds the rest of a sketch's loop takes
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+struct Layout {
+  const char *name;
+  int filler;			// other files before the tracks
+  uint32_t tagSize;
+};
+
+static const Layout layouts[] = {
+  { "tracks first, no ID3 tags", 0, 0 },
+  { "4 KB ID3 tags", 0, 4096 },
+  { "32 KB ID3 tags (cover art)", 0, 32768 },
+  { "after 200 other files", 200, 0 },
+};
+
+static void runLayout(BtUtils *bt, const Layout *layout) {
+  hostSdClear();
+  hostSdAddFiller(layout->filler);
+  for (int t = 0; t < 4; t++)
+    hostSdAddTrack(t, HOST_TRACK_LENGTH * 16 + layout->tagSize, layout->tagSize);
+
+  unsigned long startTotal = 0, soundTotal = 0, soundMax = 0, starts = 0;
+  unsigned long blocks = hostSdBlockReads();
+  for (int i = 0; i < TOUCHES; i++) {
+
+    // Like sketch 2: a touch starts the pin's track, a release stops it.
+
+    int pin = i % 4;
+    hostTouchPins(PIN_BIT(pin));
+    unsigned long touched = hostNow;
+    unsigned long end = millis() + HOLD;
+    bool sounding = false;
+    while (millis() < end) {
+      int which;
+      int status = bt->getPinTouchStatus(&which);
+      if (status == NEW_TOUCH) {
+	bt->startTrack(which);
+      } else if (status == NEW_RELEASE) {
+	bt->stopTrack();
+      }
+      if (!sounding && MP3player.track == pin && MP3player.isPlaying()) {
+	sounding = true;
+	unsigned long sound = hostNow - touched;
+	soundTotal += sound;
+	if (sound > soundMax)
+	  soundMax = sound;
+	startTotal += MP3player.lastStartMicros;
+	starts++;
+      }
+      bt->doTimerTasks();
+      hostAdvance(LOOP_REST);
+    }
+    hostTouchPins(0);
+    hostAdvance(100000);
+    int which;
+    bt->getPinTouchStatus(&which);
+    bt->stopTrack();
+    bt->doTimerTasks();
+  }
+  blocks = hostSdBlockReads() - blocks;
+  if (starts == 0)
+    starts = 1;
+  printf("  %-28s %10lu %12lu %12lu %10lu\n", layout->name, startTotal / starts,
+	 soundTotal / starts, soundMax, blocks / starts);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  printf("track start latency, us of Touch Board time (SD card at SPI_HALF_SPEED)\n");
+  printf("  %-28s %10s %12s %12s %10s\n", "card layout", "start avg",
+	 "touch->sound", "max", "SD blocks");
+  for (unsigned int i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++)
+    runLayout(bt, &layouts[i]);
+#if BTUTILS_ENABLE_STATS
+  printf("BtStats::print() for all of the above:\n");
+  hostSerialEcho = true;
+  BtStats::print();
+  hostSerialEcho = false;
+#endif
+  return 0;
+}
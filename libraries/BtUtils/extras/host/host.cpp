@@ -0,0 +1,786 @@
+/* -*-C++-*-
+ * Host (PC) build of BtUtils: the virtual clock, the Arduino core and the
+ * mock libraries. See host.h.
+ */
+
+#include <time.h>
+#include <vector>		// before Arduino.h's min() and max() macros
+#include "host.h"
+#include <SoftwareSerial.h>
+#include <avr/sleep.h>
+#include <FreeStack.h>
+
+/*----------------------------------------------------------------------
+ * Virtual clock and the Arduino core
+ ----------------------------------------------------------------------*/
+
+unsigned long hostNow = 0;
+unsigned long hostSleepMicros = 0;
+
+void hostAdvance(unsigned long us) {
+  hostNow += us;
+}
+
+void hostAdvanceTo(unsigned long us) {
+  if (us > hostNow)
+    hostNow = us;
+}
+
+unsigned long millis() { return hostNow / 1000; }
+unsigned long micros() { return hostNow; }
+void delay(unsigned long ms) { hostAdvance(ms * 1000); }
+void delayMicroseconds(unsigned int us) { hostAdvance(us); }
+
+static uint8_t pinLevel[32];
+void pinMode(uint8_t pin, uint8_t mode) { if (mode == INPUT_PULLUP) digitalWrite(pin, HIGH); }
+void digitalWrite(uint8_t pin, uint8_t value) { pinLevel[pin & 31] = value; }
+int digitalRead(uint8_t pin) { return pinLevel[pin & 31]; }
+void attachInterrupt(uint8_t, void (*)(), int) {}
+void detachInterrupt(uint8_t) {}
+
+// Idle sleep lasts until the next timer 0 tick, every 1024 microseconds,
+// which is what wakes the processor to update millis().
+void sleep_mode() {
+  unsigned long wake = (hostNow / 1024 + 1) * 1024;
+  hostSleepMicros += wake - hostNow;
+  hostNow = wake;
+}
+
+int FreeStack() { return 1000; }
+
+HardwareSerial Serial;
+bool hostSerialEcho = false;
+TwoWire Wire;
+MPR121_type MPR121;
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (hostSerialEcho)
+    putchar(c);
+  return 1;
+}
+
+size_t HardwareSerial::print(const char *s) {
+  return hostSerialEcho ? printf("%s", s) : strlen(s);
+}
+
+size_t HardwareSerial::print(char c) {
+  return write(c);
+}
+
+size_t HardwareSerial::print(long n, int base) {
+  if (base != 10)
+    return print((unsigned long)n, base);
+  return hostSerialEcho ? printf("%ld", n) : 1;
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+  if (!hostSerialEcho)
+    return 1;
+  return printf(base == 16 ? "%lx" : "%lu", n);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+  return hostSerialEcho ? printf("%.*f", digits, n) : 1;
+}
+
+size_t SoftwareSerial::write(uint8_t) {
+  bytesSent++;
+  hostAdvance(10 * 1000000UL / baud);	// start, 8 data and stop bits
+  return 1;
+}
+
+unsigned long long hostNanos() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long long)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/*----------------------------------------------------------------------
+ * MPR121. The electrodes are sampled once per sample period: each one's
+ * filtered data is its baseline less whatever the hand is doing (plus
+ * noise), it's touched above the touch threshold and released below the
+ * release threshold, and a change pulls the IRQ line low until the touch
+ * status is read.
+ ----------------------------------------------------------------------*/
+
+#define I2C_SETUP_US 12		// the Wire library's own time per transfer
+
+static MPR121_type *sensors[8];
+static uint8_t numSensors = 0;
+
+MPR121_type::MPR121_type() {
+  _inited = false;
+  _running = false;
+  _address = 0;
+  _ecrBackup = 0;
+  memset(_regs, 0, sizeof(_regs));
+  _status = 0;
+  _irq = false;
+  _lastSample = 0;
+  _touchData = _lastTouchData = 0;
+  for (int e = 0; e < MPR121_ELECTRODES; e++) {
+    _delta[e] = _offset[e] = 0;
+    _filtered[e] = _baseline[e] = MPR121_BASELINE;
+  }
+  _noise = 0;
+  _random = 12345;
+  resetCounters();
+}
+
+MPR121_type *MPR121_type::sensor(uint8_t number) {
+  return number < numSensors ? sensors[number] : NULL;
+}
+
+uint8_t MPR121_type::sensorCount() {
+  return numSensors;
+}
+
+void MPR121_type::resetCounters() {
+  transfers = bytes = registerWrites = restarts = samples = 0;
+}
+
+void MPR121_type::_transfer(unsigned int busBytes) {
+
+  // A start, the bytes (9 clocks each with the acknowledge), and a stop.
+
+  transfers++;
+  bytes += busBytes;
+  hostAdvance(I2C_SETUP_US + (busBytes * 9 + 2) * 1000000UL / Wire.clock);
+}
+
+unsigned int MPR121_type::samplePeriodMs() {
+  return 1 << (_regs[MPR121_AFE2] & 0x07);
+}
+
+uint16_t MPR121_type::_sensed() {
+  if (!_running)
+    return _status;
+  unsigned long now = millis();
+  unsigned int period = samplePeriodMs();
+  if (now - _lastSample < period)
+    return _status;
+  samples += (now - _lastSample) / period;
+  _lastSample = now - (now - _lastSample) % period;
+  uint16_t status = 0;
+  for (int e = 0; e < MPR121_ELECTRODES; e++) {
+    int jitter = 0;
+    if (_noise > 0) {
+      _random = _random * 1103515245 + 12345;
+      jitter = (int)((_random >> 16) % (2 * _noise + 1)) - _noise;
+    }
+    if (_delta[e] < _offset[e])
+      _offset[e] = _delta[e];
+    _baseline[e] = MPR121_BASELINE - _offset[e];
+    _filtered[e] = MPR121_BASELINE - _delta[e] + jitter;
+    int delta = _baseline[e] - _filtered[e];
+    bool touched = (_status >> e) & 1;
+    if (touched ? delta >= _regs[MPR121_E0RTH + 2 * e] : delta > _regs[MPR121_E0TTH + 2 * e])
+      status |= 1 << e;
+  }
+  if (status != _status)
+    _irq = true;
+  _status = status;
+  return _status;
+}
+
+bool MPR121_type::begin(uint8_t address, uint8_t touchThreshold,
+			uint8_t releaseThreshold, uint8_t interruptPin) {
+  int i;
+  for (i = 0; i < numSensors && sensors[i] != this; i++)
+    ;
+  if (i == numSensors)
+    sensors[numSensors++] = this;
+  _address = address;
+  _inited = true;
+  _regs[MPR121_AFE1] = 0x10;		// 6 samples in the first filter, 16 uA
+  _regs[MPR121_AFE2] = 0x20 | SAMPLE_INTERVAL_1MS;
+  for (int e = 0; e < MPR121_ELECTRODES; e++) {
+    _regs[MPR121_E0TTH + 2 * e] = touchThreshold;
+    _regs[MPR121_E0RTH + 2 * e] = releaseThreshold;
+  }
+  _regs[MPR121_ECR] = 0x8C;		// baseline tracking, 12 electrodes
+  _running = true;
+  _irq = false;
+  _lastSample = millis();
+  setInterruptPin(interruptPin);
+  resetCounters();
+  return true;
+}
+
+void MPR121_type::setInterruptPin(uint8_t pin) {
+  (void)pin;
+}
+
+bool MPR121_type::touchStatusChanged() {
+  _sensed();
+  return _inited && _irq;
+}
+
+void MPR121_type::updateTouchData() {
+  _transfer(3 + 2);
+  _lastTouchData = _touchData;
+  _touchData = _sensed();
+  _irq = false;
+}
+
+bool MPR121_type::updateBaselineData() {
+  _transfer(3 + MPR121_ELECTRODES);
+  _sensed();
+  return true;
+}
+
+bool MPR121_type::updateFilteredData() {
+  _transfer(3 + 2 * MPR121_ELECTRODES);
+  _sensed();
+  return true;
+}
+
+void MPR121_type::updateAll() {
+  updateTouchData();
+  updateBaselineData();
+  updateFilteredData();
+}
+
+bool MPR121_type::getTouchData(uint8_t electrode) {
+  return (_touchData >> electrode) & 1;
+}
+
+uint8_t MPR121_type::getNumTouches() {
+  return __builtin_popcount(_touchData);
+}
+
+int MPR121_type::getFilteredData(uint8_t electrode) {
+  return electrode < MPR121_ELECTRODES ? _filtered[electrode] : 0;
+}
+
+int MPR121_type::getBaselineData(uint8_t electrode) {
+  return electrode < MPR121_ELECTRODES ? _baseline[electrode] & ~3 : 0;	// read as 8 bits, << 2
+}
+
+bool MPR121_type::isNewTouch(uint8_t electrode) {
+  return !((_lastTouchData >> electrode) & 1) && ((_touchData >> electrode) & 1);
+}
+
+bool MPR121_type::isNewRelease(uint8_t electrode) {
+  return ((_lastTouchData >> electrode) & 1) && !((_touchData >> electrode) & 1);
+}
+
+void MPR121_type::setTouchThreshold(uint8_t threshold) {
+  for (uint8_t e = 0; e < MPR121_ELECTRODES; e++)
+    setTouchThreshold(e, threshold);
+}
+
+void MPR121_type::setTouchThreshold(uint8_t electrode, uint8_t threshold) {
+  if (electrode < MPR121_ELECTRODES)
+    setRegister(MPR121_E0TTH + 2 * electrode, threshold);
+}
+
+void MPR121_type::setReleaseThreshold(uint8_t threshold) {
+  for (uint8_t e = 0; e < MPR121_ELECTRODES; e++)
+    setReleaseThreshold(e, threshold);
+}
+
+void MPR121_type::setReleaseThreshold(uint8_t electrode, uint8_t threshold) {
+  if (electrode < MPR121_ELECTRODES)
+    setRegister(MPR121_E0RTH + 2 * electrode, threshold);
+}
+
+uint8_t MPR121_type::getTouchThreshold(uint8_t electrode) {
+  return getRegister(MPR121_E0TTH + 2 * electrode);
+}
+
+uint8_t MPR121_type::getReleaseThreshold(uint8_t electrode) {
+  return getRegister(MPR121_E0RTH + 2 * electrode);
+}
+
+void MPR121_type::setRegister(uint8_t reg, uint8_t value) {
+
+  // As in the real library: the MPR121 has to be stopped to change any
+  // of its configuration, so that write is wrapped in stop() and run().
+
+  bool wasRunning = false;
+  if (reg == MPR121_ECR) {
+    _running = (value & 0x3F) != 0;
+  } else if (reg < MPR121_CTL0) {
+    wasRunning = _running;
+    if (wasRunning)
+      stop();
+  }
+  _transfer(3);
+  registerWrites++;
+  if (reg <= MPR121_SRST)
+    _regs[reg] = value;
+  if (wasRunning) {
+    run();
+    restarts++;
+  }
+}
+
+uint8_t MPR121_type::getRegister(uint8_t reg) {
+  _transfer(3 + 1);
+  return reg <= MPR121_SRST ? _regs[reg] : 0;
+}
+
+void MPR121_type::setSamplePeriod(mpr121_sample_interval_type period) {
+  uint8_t scratch = getRegister(MPR121_AFE2);
+  setRegister(MPR121_AFE2, (scratch & 0xF8) | (period & 0x07));
+}
+
+void MPR121_type::stop() {
+  _ecrBackup = getRegister(MPR121_ECR);
+  setRegister(MPR121_ECR, _ecrBackup & 0xC0);
+}
+
+void MPR121_type::run() {
+  setRegister(MPR121_ECR, _ecrBackup);
+  _lastSample = millis();		// starts sampling again from now
+  if (_ecrBackup & 0x80) {
+    for (int e = 0; e < MPR121_ELECTRODES; e++)
+      _offset[e] = _delta[e];		// a new baseline, from the first readings
+  }
+}
+
+void MPR121_type::touch(uint16_t electrodes) {
+  for (int e = 0; e < PINS_PER_SENSOR; e++)
+    _delta[e] = ((electrodes >> e) & 1) ? HOST_TOUCH_DELTA : 0;
+}
+
+void MPR121_type::setProximity(uint8_t electrode, int delta) {
+  if (electrode < MPR121_ELECTRODES)
+    _delta[electrode] = delta;
+}
+
+void MPR121_type::setNoise(int amplitude) {
+  _noise = amplitude;
+}
+
+void hostTouchPins(PinSet pins) {
+  for (uint8_t s = 0; s < numSensors; s++)
+    sensors[s]->touch((uint16_t)((pins >> (s * PINS_PER_SENSOR)) & 0xFFF));
+}
+
+void hostSetProximity(int pin, int delta) {
+  MPR121_type *sensor = MPR121_type::sensor(pin / PINS_PER_SENSOR);
+  if (sensor)
+    sensor->setProximity(pin % PINS_PER_SENSOR, delta);
+}
+
+unsigned long hostI2cTransfers() {
+  unsigned long n = 0;
+  for (uint8_t s = 0; s < numSensors; s++)
+    n += sensors[s]->transfers;
+  return n;
+}
+
+unsigned long hostI2cBytes() {
+  unsigned long n = 0;
+  for (uint8_t s = 0; s < numSensors; s++)
+    n += sensors[s]->bytes;
+  return n;
+}
+
+void hostResetCounters() {
+  for (uint8_t s = 0; s < numSensors; s++)
+    sensors[s]->resetCounters();
+}
+
+void hostTraceStart(HostTrace *trace, const HostTraceEvent *events, int count) {
+  trace->events = events;
+  trace->count = count;
+  trace->next = 0;
+}
+
+void hostTracePlay(HostTrace *trace) {
+  while (trace->next < trace->count && trace->events[trace->next].ms <= millis()) {
+    const HostTraceEvent *e = &trace->events[trace->next++];
+    hostSetProximity(e->pin, e->delta);
+  }
+}
+
+/*----------------------------------------------------------------------
+ * SD card
+ ----------------------------------------------------------------------*/
+
+struct HostSdFile {
+  char name[13];
+  uint32_t size;		// MP3 files: made up on the fly
+  uint32_t tagSize;
+  bool mp3;
+  std::vector<uint8_t> data;	// other files
+};
+static std::vector<HostSdFile> card;
+static long cachedBlock = -1;	// file index << 16 | block, or -1
+static unsigned long blockReads = 0, blockWrites = 0;
+static bool cardMade = false;
+
+static void makeDefaultCard() {
+
+  // Unless a test sets up its own: TRACK000.MP3 to TRACK011.MP3, each a
+  // minute at 128 kbps, with no ID3 tags.
+
+  if (cardMade)
+    return;
+  cardMade = true;
+  for (int t = 0; t < 12; t++)
+    hostSdAddTrack(t, HOST_TRACK_LENGTH * 16, 0);
+}
+
+void hostSdClear() {
+  card.clear();
+  cachedBlock = -1;
+  cardMade = true;
+}
+
+void hostSdAddTrack(int trackNumber, uint32_t size, uint32_t tagSize) {
+  cardMade = true;
+  HostSdFile f;
+  snprintf(f.name, sizeof(f.name), "TRACK%03d.MP3", trackNumber);
+  f.size = size;
+  f.tagSize = tagSize;
+  f.mp3 = true;
+  card.push_back(f);
+}
+
+void hostSdAddFiller(int count) {
+  cardMade = true;
+  for (int i = 0; i < count; i++) {
+    HostSdFile f;
+    snprintf(f.name, sizeof(f.name), "NOTE%04d.TXT", (int)card.size());
+    f.size = 0;
+    f.tagSize = 0;
+    f.mp3 = false;
+    card.push_back(f);
+  }
+}
+
+unsigned long hostSdBlockReads() { return blockReads; }
+unsigned long hostSdBlockWrites() { return blockWrites; }
+
+static void readBlock(long block) {
+  if (block == cachedBlock)
+    return;
+  cachedBlock = block;
+  blockReads++;
+  hostAdvance(HOST_SD_READ_US);
+}
+
+static int findFile(const char *path) {
+  makeDefaultCard();
+
+  // Reading the directory a block at a time until the name turns up
+  // (directory blocks are "file" 0xFFFF in the cache).
+
+  for (size_t i = 0; i < card.size(); i++) {
+    if (i % HOST_SD_DIR_ENTRIES == 0)
+      readBlock(0xFFFFL << 16 | (i / HOST_SD_DIR_ENTRIES));
+    if (strcasecmp(card[i].name, path) == 0)
+      return (int)i;
+  }
+  return -1;
+}
+
+bool SdFat::begin(uint8_t, uint8_t) {
+  makeDefaultCard();
+  _root._index = FatFile::ROOT;
+  return true;
+}
+
+bool SdFat::exists(const char *path) {
+  return findFile(path) >= 0;
+}
+
+bool FatFile::open(const char *path, uint8_t oflag) {
+  int i = findFile(path);
+  if (i < 0) {
+    if (!(oflag & O_CREAT))
+      return false;
+    HostSdFile f;
+    snprintf(f.name, sizeof(f.name), "%s", path);
+    f.size = 0;
+    f.tagSize = 0;
+    f.mp3 = false;
+    card.push_back(f);
+    i = (int)card.size() - 1;
+  }
+  if (oflag & O_TRUNC)
+    card[i].data.clear();
+  _index = i;
+  _pos = 0;
+  return true;
+}
+
+bool FatFile::openNext(FatFile *dir, uint8_t) {
+  makeDefaultCard();
+  if ((size_t)dir->_next >= card.size())
+    return false;
+  if (dir->_next % HOST_SD_DIR_ENTRIES == 0)
+    readBlock(0xFFFFL << 16 | (dir->_next / HOST_SD_DIR_ENTRIES));
+  _index = dir->_next++;
+  _pos = 0;
+  return true;
+}
+
+uint32_t FatFile::fileSize() const {
+  if (_index < 0)
+    return 0;
+  const HostSdFile &f = card[_index];
+  return f.mp3 ? f.size : f.data.size();
+}
+
+static uint8_t mp3Byte(const HostSdFile &f, uint32_t pos) {
+
+  // An ID3v2 tag of f.tagSize bytes (if any), then MPEG-1 layer III
+  // frames at 128 kbps, 44.1 kHz; only the headers are filled in.
+
+  if (pos < f.tagSize) {
+    uint32_t body = f.tagSize - 10;
+    switch (pos) {
+    case 0: return 'I';
+    case 1: return 'D';
+    case 2: return '3';
+    case 3: return 3;
+    case 6: return (body >> 21) & 0x7F;
+    case 7: return (body >> 14) & 0x7F;
+    case 8: return (body >> 7) & 0x7F;
+    case 9: return body & 0x7F;
+    default: return 0;
+    }
+  }
+  static const uint8_t header[4] = { 0xFF, 0xFB, 0x90, 0x64 };
+  uint32_t inFrame = (pos - f.tagSize) % 417;
+  return inFrame < 4 ? header[inFrame] : 0;
+}
+
+int FatFile::read(void *buf, size_t count) {
+  if (_index < 0)
+    return -1;
+  const HostSdFile &f = card[_index];
+  uint32_t size = fileSize();
+  if (_pos >= size)
+    return 0;
+  if (count > size - _pos)
+    count = size - _pos;
+  uint8_t *out = (uint8_t *)buf;
+  for (size_t n = 0; n < count; n++, _pos++) {
+    readBlock((long)_index << 16 | (_pos / HOST_SD_BLOCK));
+    out[n] = f.mp3 ? mp3Byte(f, _pos) : f.data[_pos];
+  }
+  return (int)count;
+}
+
+int FatFile::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t FatFile::write(const void *buf, size_t count) {
+  if (_index < 0 || card[_index].mp3)
+    return 0;
+  HostSdFile &f = card[_index];
+  if (f.data.size() < _pos + count)
+    f.data.resize(_pos + count);
+  memcpy(&f.data[_pos], buf, count);
+  uint32_t blocks = (_pos + count + HOST_SD_BLOCK - 1) / HOST_SD_BLOCK - _pos / HOST_SD_BLOCK;
+  blockWrites += blocks;
+  hostAdvance(blocks * HOST_SD_WRITE_US);
+  _pos += count;
+  return count;
+}
+
+bool FatFile::seekSet(uint32_t pos) {
+  if (_index < 0 || pos > fileSize())
+    return false;
+  _pos = pos;
+  return true;
+}
+
+bool FatFile::getSFN(char *name) {
+  if (_index < 0)
+    return false;
+  strcpy(name, card[_index].name);
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * MP3 player
+ ----------------------------------------------------------------------*/
+
+#define VS1053_FIFO     2048	// bytes the first refill sends
+#define VS1053_SDI_US   4	// per byte sent to the codec (SPI plus overhead)
+#define VS1053_SCI_US   30	// per register write
+
+SFEMP3Shield::SFEMP3Shield() {
+  _state = uninitialized;
+  volumeLeft = volumeRight = 0;
+  volumeWrites = 0;
+  dataStreamPauses = 0;
+  lastStartMicros = 0;
+  track = -1;
+  _playStart = _pausedAt = 0;
+}
+
+uint8_t SFEMP3Shield::begin() {
+  _state = ready;
+  return 0;
+}
+
+uint8_t SFEMP3Shield::playTrack(uint8_t trackNo) {
+  char name[13];
+  snprintf(name, sizeof(name), "track%03d.mp3", trackNo);
+  uint8_t result = playMP3(name, 0);
+  if (result == 0)
+    track = trackNo;
+  return result;
+}
+
+uint8_t SFEMP3Shield::playMP3(char *fileName, uint32_t timecode) {
+
+  // Like the real one: find the file, read up to the first frame header
+  // (a byte at a time, through any ID3 tag) for the bit rate, then fill
+  // the codec's buffer; the first sound comes out after that.
+
+  unsigned long start = hostNow;
+  if (isPlaying())
+    return 1;
+  if (!_file.open(fileName, O_READ))
+    return 2;
+  int c, last = 0;
+  while ((c = _file.read()) >= 0 && !(last == 0xFF && (c & 0xE0) == 0xE0))
+    last = c;
+  uint8_t buffer[VS1053_FIFO];
+  int n = _file.read(buffer, sizeof(buffer));
+  hostAdvance((n > 0 ? n : 0) * VS1053_SDI_US);
+  _state = playback;
+  _playStart = millis() - timecode;
+  lastStartMicros = hostNow - start;
+  return 0;
+}
+
+unsigned long SFEMP3Shield::_positionMs() {
+  if (_state == paused_playback)
+    return _pausedAt - _playStart;
+  return millis() - _playStart;
+}
+
+uint8_t SFEMP3Shield::getState() {
+  if (_state == playback && _positionMs() >= HOST_TRACK_LENGTH) {
+    _state = ready;			// played to the end
+    _file.close();
+  }
+  return _state;
+}
+
+void SFEMP3Shield::stopTrack() {
+  if (getState() != playback && _state != paused_playback)
+    return;
+  hostAdvance(VS1053_SCI_US);
+  _state = ready;
+  _file.close();
+}
+
+uint8_t SFEMP3Shield::isPlaying() {
+  uint8_t state = getState();
+  return (state == playback || state == paused_playback) ? 1 : 0;
+}
+
+uint8_t SFEMP3Shield::skipTo(uint32_t timecode) {
+  if (!isPlaying())
+    return 1;
+  hostAdvance(HOST_SD_READ_US);		// seeking reads a block
+  _playStart = millis() - timecode;
+  if (_state == paused_playback)
+    _pausedAt = millis();
+  return 0;
+}
+
+uint32_t SFEMP3Shield::currentPosition() {
+  return isPlaying() ? _positionMs() : 0;
+}
+
+void SFEMP3Shield::setVolume(uint8_t leftChannel, uint8_t rightChannel) {
+  hostAdvance(VS1053_SCI_US);
+  volumeLeft = leftChannel;
+  volumeRight = rightChannel;
+  volumeWrites++;
+}
+
+void SFEMP3Shield::pauseDataStream() {
+  if (getState() == playback) {
+    disableRefill();
+    _pausedAt = millis();
+    _state = paused_playback;
+    dataStreamPauses++;
+  }
+}
+
+void SFEMP3Shield::resumeDataStream() {
+  if (_state == paused_playback) {
+    _playStart += millis() - _pausedAt;
+    _state = playback;
+    enableRefill();
+  }
+}
+
+void SFEMP3Shield::pauseMusic() {
+  pauseDataStream();
+}
+
+void SFEMP3Shield::resumeMusic() {
+  resumeDataStream();
+}
+
+uint8_t SFEMP3Shield::resumeMusic(uint32_t timecode) {
+  resumeDataStream();
+  return skipTo(timecode);
+}
+
+uint16_t SFEMP3Shield::Mp3ReadWRAM(uint16_t address) {
+
+  // The decoder knows the byte rate once it has decoded a few frames.
+
+  hostAdvance(VS1053_SCI_US);
+  if (address == para_byteRate && isPlaying() && _positionMs() >= 50)
+    return 16000;
+  return 0;
+}
+
+/*----------------------------------------------------------------------
+ * Benchmark and test helpers
+ ----------------------------------------------------------------------*/
+
+void hostCallBegin(HostCallStats *s) {
+  s->startUs = hostNow;
+  s->startTransfers = hostI2cTransfers();
+  s->startBytes = hostI2cBytes();
+  s->startNs = hostNanos();
+}
+
+void hostCallEnd(HostCallStats *s) {
+  unsigned long long ns = hostNanos() - s->startNs;
+  unsigned long us = hostNow - s->startUs;
+  s->calls++;
+  s->totalUs += us;
+  if (us > s->maxUs)
+    s->maxUs = us;
+  s->transfers += hostI2cTransfers() - s->startTransfers;
+  s->bytes += hostI2cBytes() - s->startBytes;
+  s->totalNs += ns;
+}
+
+void hostCallPrintHeader() {
+  printf("  %-22s %8s %9s %8s %9s %9s %8s\n", "call", "calls",
+	 "avg us", "max us", "I2C/call", "B/call", "host ns");
+}
+
+void hostCallPrint(const HostCallStats *s) {
+  double n = s->calls ? (double)s->calls : 1.0;
+  printf("  %-22s %8lu %9.2f %8lu %9.4f %9.3f %8.0f\n", s->name, s->calls,
+	 s->totalUs / n, s->maxUs, s->transfers / n, s->bytes / n, s->totalNs / n);
+}
+
+int hostFailures = 0;
+
+int hostResult(const char *testName) {
+  printf("%s: %s\n", testName, hostFailures ? "FAILED" : "passed");
+  return hostFailures ? 1 : 0;
+}
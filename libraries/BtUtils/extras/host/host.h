@@ -0,0 +1,87 @@
+/* -*-C++-*-
+ * Host (PC) build of BtUtils: the virtual clock, the hand that touches
+ * the pins, and a few helpers shared by the tests and benchmarks. The
+ * mock MPR121, SFEMP3Shield and SdFat are in stubs/; all of it is
+ * implemented in host.cpp.
+ *
+ * Nothing here runs unless a test moves the clock: the virtual clock only
+ * goes forward when a test says so (the rest of the sketch's loop, a
+ * visitor waiting) or when a mock does something that would take time on
+ * the Touch Board (an I2C transfer, an SD card block, sleeping until the
+ * next timer tick). So the virtual time a call takes is the time the
+ * hardware would have kept the loop waiting, and it's the same on every
+ * run. Host CPU time is also measured, but only means something compared
+ * with another host measurement.
+ */
+
+#ifndef host_h
+#define host_h 1
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <MPR121.h>
+#include <SFEMP3Shield.h>
+#include <SdFat.h>
+#include "BtUtils.h"
+
+// The virtual clock, in microseconds since reset; millis() and micros()
+// read it.
+extern unsigned long hostNow;
+void hostAdvance(unsigned long us);
+void hostAdvanceTo(unsigned long us);
+extern unsigned long hostSleepMicros;	// of hostNow, spent in sleep_mode()
+
+// Pins by BtUtils pin number, over all the sensors. A touched pin reads
+// HOST_TOUCH_DELTA below its baseline; proximity is any smaller amount.
+#define HOST_TOUCH_DELTA 100
+void hostTouchPins(PinSet pins);
+void hostSetProximity(int pin, int delta);
+
+// A scripted visitor: at each event's time, a pin's reading changes.
+struct HostTraceEvent {
+  unsigned long ms;
+  int8_t pin;
+  uint8_t delta;		// 0 is nothing near, HOST_TOUCH_DELTA is touched
+};
+struct HostTrace {
+  const HostTraceEvent *events;
+  int count;
+  int next;
+};
+void hostTraceStart(HostTrace *trace, const HostTraceEvent *events, int count);
+void hostTracePlay(HostTrace *trace);	// applies everything due by now
+
+// I2C totals over all the sensors since the last reset
+unsigned long hostI2cTransfers();
+unsigned long hostI2cBytes();
+void hostResetCounters();
+
+// Host CPU time, for benchmarks
+unsigned long long hostNanos();
+
+// Timing of one kind of call in a benchmark: virtual (Touch Board) time,
+// I2C traffic, and host CPU time.
+struct HostCallStats {
+  HostCallStats(const char *callName)
+    : name(callName), calls(0), totalUs(0), maxUs(0), transfers(0), bytes(0), totalNs(0) {}
+  const char *name;
+  unsigned long calls;
+  unsigned long totalUs, maxUs;
+  unsigned long transfers, bytes;
+  unsigned long long totalNs;
+  unsigned long startUs, startTransfers, startBytes;	// of the call going on
+  unsigned long long startNs;
+};
+void hostCallBegin(HostCallStats *s);
+void hostCallEnd(HostCallStats *s);
+void hostCallPrintHeader();
+void hostCallPrint(const HostCallStats *s);
+
+// Test checks: report failures and carry on; main() returns hostResult().
+extern int hostFailures;
+#define HOST_CHECK(cond)						\
+  do { if (!(cond)) { hostFailures++;					\
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+int hostResult(const char *testName);
+
+#endif
@@ -0,0 +1,12 @@
+/* -*-C++-*-
+ * Prints sizeof(BtUtils) for sizes.sh: the RAM the one BtUtils object
+ * takes with the BTUTILS_ENABLE_xxx settings it's compiled with.
+ */
+
+#include <stdio.h>
+#include "BtUtils.h"
+
+int main() {
+  printf("%u\n", (unsigned)sizeof(BtUtils));
+  return 0;
+}
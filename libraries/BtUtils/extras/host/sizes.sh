@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Size report: compiles BtUtils.cpp with each set of BTUTILS_ENABLE_xxx
+# settings below and prints its code, its static data, and the size of
+# the BtUtils object. Run by "make sizes".
+#
+# These are PC (x86-64) sizes, so they are bigger than on the Touch
+# Board and don't match what the Arduino IDE reports; what they show is
+# what each setting adds compared with the others.
+
+CXX=${CXX:-g++}
+FLAGS="-std=gnu++11 -Os -I../.. -Istubs -I."
+mkdir -p build
+
+# name, then the settings that differ from BtUtils.h
+SETS="
+smallest:-DBTUTILS_ENABLE_FADES=0 -DBTUTILS_ENABLE_START_AFTER_DELAY=0 -DBTUTILS_ENABLE_PROXIMITY=0 -DBTUTILS_ENABLE_RESUME=0
+defaults:
++TOUCH_EVENTS:-DBTUTILS_ENABLE_TOUCH_EVENTS=1
++TRACK_CATALOG:-DBTUTILS_ENABLE_TRACK_CATALOG=1
++IDLE:-DBTUTILS_ENABLE_IDLE=1
++CALIBRATION:-DBTUTILS_ENABLE_CALIBRATION=1
++MIDI:-DBTUTILS_ENABLE_MIDI=1
++STATS:-DBTUTILS_ENABLE_STATS=1
+everything:-DBTUTILS_ENABLE_TOUCH_EVENTS=1 -DBTUTILS_ENABLE_TRACK_CATALOG=1 -DBTUTILS_ENABLE_IDLE=1 -DBTUTILS_ENABLE_CALIBRATION=1 -DBTUTILS_ENABLE_MIDI=1 -DBTUTILS_ENABLE_STATS=1
+"
+
+echo "BtUtils sizes by settings, in bytes on a PC (compare rows only)"
+printf "  %-16s %8s %8s %8s %8s\n" "settings" "code" "data" "bss" "object"
+echo "$SETS" | while IFS=: read name defs; do
+  [ -n "$name" ] || continue
+  $CXX $FLAGS $defs -c -o build/size.o ../../BtUtils.cpp || exit 1
+  $CXX $FLAGS $defs -o build/size sizes.cpp || exit 1
+  set -- $(size build/size.o | tail -1)
+  printf "  %-16s %8s %8s %8s %8s\n" "$name" "$1" "$2" "$3" "$(build/size)"
+done
@@ -0,0 +1,96 @@
+/* -*-C++-*-
+ * Stand-in for the Arduino core, just enough of it for BtUtils to compile
+ * on a PC. Time comes from the virtual clock in host.cpp, which only moves
+ * when the mocks say the hardware would have taken time, or when a test
+ * moves it. See ../host.h.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h 1
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define LED_BUILTIN 13
+#define SD_SEL 5
+#define SPI_HALF_SPEED 1
+static const uint8_t A0 = 18, A1 = 19, A2 = 20, A3 = 21, A4 = 22, A5 = 23;
+
+// The Touch Board's MPR121 IRQ line (pin 4) can't raise an interrupt.
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 4 ? NOT_AN_INTERRUPT : (p))
+
+#define PROGMEM
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#ifndef max
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#define constrain(x,lo,hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+inline long map(long x, long inLo, long inHi, long outLo, long outHi) {
+  return (x - inLo) * (outHi - outLo) / (inHi - inLo) + outLo;
+}
+
+#define noInterrupts()
+#define interrupts()
+#define cli()
+#define sei()
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+// Serial output goes to stdout if hostSerialEcho is set, else nowhere.
+class HardwareSerial {
+ public:
+  void begin(long baud) { (void)baud; }
+  void end() {}
+  int availableForWrite() { return 63; }
+  void flush() { fflush(stdout); }
+  operator bool() { return true; }
+  size_t write(uint8_t c);
+  size_t print(const __FlashStringHelper *s) { return print((const char *)s); }
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(int n, int base = 10) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = 10) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = 10);
+  size_t print(unsigned long n, int base = 10);
+  size_t print(double n, int digits = 2);
+  size_t println() { return print('\n'); }
+  template <typename T> size_t println(T x) { return print(x) + println(); }
+  template <typename T> size_t println(T x, int format) { return print(x, format) + println(); }
+};
+extern HardwareSerial Serial;
+extern bool hostSerialEcho;
+
+#endif
@@ -0,0 +1,5 @@
+/* Stand-in for SdFat's FreeStack(): a PC has no RAM to count. */
+#ifndef FreeStack_h
+#define FreeStack_h 1
+int FreeStack();
+#endif
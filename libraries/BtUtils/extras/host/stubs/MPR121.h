@@ -0,0 +1,112 @@
+/* -*-C++-*-
+ * Stand-in for Bare Conductive's MPR121 library. The calls BtUtils makes
+ * behave like the real ones, register by register, and each I2C transfer
+ * takes the time it would at the Wire clock speed. The test plays the
+ * hand: touch() and setProximity() say what the electrodes sense.
+ *
+ * The baseline stays put (the real one follows slow drift, which tests
+ * don't make), except that a restart with the ECR's calibration lock bits
+ * at 10 or 11 takes a new one from the first readings, hand and all, and
+ * a baseline left too low like that comes back up as soon as the hand
+ * goes away.
+ */
+
+#ifndef MPR121_h
+#define MPR121_h 1
+
+#include <Arduino.h>
+
+enum mpr121_register {
+  MPR121_TS1 = 0x00, MPR121_TS2 = 0x01, MPR121_OORS1 = 0x02, MPR121_OORS2 = 0x03,
+  MPR121_E0FDL = 0x04, MPR121_E0BV = 0x1E,
+  MPR121_MHDR = 0x2B, MPR121_NHDR = 0x2C, MPR121_NCLR = 0x2D, MPR121_FDLR = 0x2E,
+  MPR121_MHDF = 0x2F, MPR121_NHDF = 0x30, MPR121_NCLF = 0x31, MPR121_FDLF = 0x32,
+  MPR121_NHDT = 0x33, MPR121_NCLT = 0x34, MPR121_FDLT = 0x35,
+  MPR121_E0TTH = 0x41, MPR121_E0RTH = 0x42,
+  MPR121_DTR = 0x5B, MPR121_AFE1 = 0x5C, MPR121_AFE2 = 0x5D, MPR121_ECR = 0x5E,
+  MPR121_CDC0 = 0x5F, MPR121_CDT01 = 0x6C, MPR121_CTL0 = 0x73,
+  MPR121_ACCR0 = 0x7B, MPR121_ACCR1 = 0x7C, MPR121_USL = 0x7D, MPR121_LSL = 0x7E,
+  MPR121_TL = 0x7F, MPR121_SRST = 0x80
+};
+
+enum mpr121_sample_interval_type {
+  SAMPLE_INTERVAL_1MS = 0x00, SAMPLE_INTERVAL_2MS, SAMPLE_INTERVAL_4MS,
+  SAMPLE_INTERVAL_8MS, SAMPLE_INTERVAL_16MS, SAMPLE_INTERVAL_32MS,
+  SAMPLE_INTERVAL_64MS, SAMPLE_INTERVAL_128MS
+};
+
+#define MPR121_ELECTRODES 13	// 12 pins and the proximity electrode
+#define MPR121_BASELINE   600	// what the mock's electrodes read untouched
+
+class MPR121_type {
+ public:
+  MPR121_type();
+
+  // The library's interface (the parts BtUtils uses)
+  bool begin(uint8_t address = 0x5C, uint8_t touchThreshold = 40,
+	     uint8_t releaseThreshold = 20, uint8_t interruptPin = 4);
+  void setInterruptPin(uint8_t pin);
+  bool touchStatusChanged();
+  void updateTouchData();
+  bool updateBaselineData();
+  bool updateFilteredData();
+  void updateAll();
+  bool getTouchData(uint8_t electrode);
+  uint8_t getNumTouches();
+  int getFilteredData(uint8_t electrode);
+  int getBaselineData(uint8_t electrode);
+  bool isNewTouch(uint8_t electrode);
+  bool isNewRelease(uint8_t electrode);
+  void setTouchThreshold(uint8_t threshold);
+  void setTouchThreshold(uint8_t electrode, uint8_t threshold);
+  void setReleaseThreshold(uint8_t threshold);
+  void setReleaseThreshold(uint8_t electrode, uint8_t threshold);
+  uint8_t getTouchThreshold(uint8_t electrode);
+  uint8_t getReleaseThreshold(uint8_t electrode);
+  void setRegister(uint8_t reg, uint8_t value);
+  uint8_t getRegister(uint8_t reg);
+  void setSamplePeriod(mpr121_sample_interval_type period);
+  void stop();
+  void run();
+  bool isRunning() { return _running; }
+  bool isInited() { return _inited; }
+
+  // The simulation's side. Sensors are numbered in the order begin() was
+  // called on them, which is BtUtils's sensor order.
+
+  static MPR121_type *sensor(uint8_t number);
+  static uint8_t sensorCount();
+  void touch(uint16_t electrodes);	// sensed one sample period from now
+  void setProximity(uint8_t electrode, int delta);
+  void setNoise(int amplitude);		// filtered data jitters this much
+  unsigned int samplePeriodMs();
+  void resetCounters();
+
+  unsigned long transfers;		// I2C transactions
+  unsigned long bytes;			// bytes on the bus, addresses included
+  unsigned long registerWrites;
+  unsigned long restarts;		// stop/run around a configuration write
+  unsigned long samples;		// sample periods while running
+
+ private:
+  void _transfer(unsigned int busBytes);
+  uint16_t _sensed();
+
+  bool _inited, _running;
+  uint8_t _address, _ecrBackup;
+  uint8_t _regs[MPR121_SRST + 1];
+  uint16_t _status;			// as of the last sample
+  bool _irq;				// the IRQ line is low
+  unsigned long _lastSample;		// virtual milliseconds
+  uint16_t _touchData, _lastTouchData;
+  int _delta[MPR121_ELECTRODES];	// what the hand does
+  int _offset[MPR121_ELECTRODES];	// of it, taken into the baseline
+  int _filtered[MPR121_ELECTRODES];
+  int _baseline[MPR121_ELECTRODES];
+  int _noise;
+  uint32_t _random;
+};
+
+extern MPR121_type MPR121;
+
+#endif
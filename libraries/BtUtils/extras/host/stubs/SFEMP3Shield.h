@@ -0,0 +1,68 @@
+/* -*-C++-*-
+ * Stand-in for the SFEMP3Shield (VS1053) library. A track "plays" on the
+ * virtual clock; starting one reads the file from the SdFat mock the way
+ * the real library does (find it, read past the ID3 tag to the first
+ * frame, fill the codec's buffer), so it takes as long as those SD card
+ * reads would. Volume writes are kept so a test can see what the codec
+ * was told.
+ */
+
+#ifndef SFEMP3Shield_h
+#define SFEMP3Shield_h 1
+
+#include <SdFat.h>
+
+enum state_m {
+  uninitialized, initialized, deactivated, loading, ready,
+  playback, paused_playback, testing_memory, testing_sinewave
+};
+
+#define para_byteRate 0x1E05
+
+#define HOST_TRACK_LENGTH 60000UL	// milliseconds each track plays for
+
+class SFEMP3Shield {
+ public:
+  SFEMP3Shield();
+
+  // The library's interface (the parts BtUtils uses)
+  uint8_t begin();
+  void end() {}
+  uint8_t playTrack(uint8_t trackNo);
+  uint8_t playMP3(char *fileName, uint32_t timecode = 0);
+  void stopTrack();
+  uint8_t isPlaying();
+  uint8_t skipTo(uint32_t timecode);
+  uint32_t currentPosition();
+  void setVolume(uint8_t leftChannel, uint8_t rightChannel);
+  void setVolume(uint16_t both) { setVolume((uint8_t)(both >> 8), (uint8_t)both); }
+  void setVolume(uint8_t both) { setVolume(both, both); }
+  uint16_t getVolume() { return ((uint16_t)volumeLeft << 8) | volumeRight; }
+  void pauseDataStream();
+  void resumeDataStream();
+  void pauseMusic();
+  void resumeMusic();
+  uint8_t resumeMusic(uint32_t timecode);
+  static void available() {}
+  uint8_t getState();
+  uint16_t Mp3ReadWRAM(uint16_t address);
+
+  // The simulation's side
+  uint8_t volumeLeft, volumeRight;	// last volume written (0 is loudest)
+  unsigned long volumeWrites;
+  unsigned long dataStreamPauses;
+  unsigned long lastStartMicros;	// how long the last playTrack() took
+  int track;				// -1 if none
+
+ private:
+  void enableRefill() {}		// private in the real library too
+  void disableRefill() {}
+  unsigned long _positionMs();
+
+  state_m _state;
+  SdFile _file;
+  unsigned long _playStart;		// virtual ms at position zero
+  unsigned long _pausedAt;
+};
+
+#endif
@@ -0,0 +1 @@
+/* Stand-in for the Arduino SPI library: nothing here is needed. */
@@ -0,0 +1,74 @@
+/* -*-C++-*-
+ * Stand-in for the SdFat library: a one-directory card in memory. MP3
+ * files are made up on the fly (an ID3 tag of the given size, then a 128
+ * kbps MPEG frame header), other files keep what's written to them. Each
+ * card block read or written takes HOST_SD_READ_US or HOST_SD_WRITE_US on
+ * the virtual clock; like SdFat, the last block read is cached.
+ */
+
+#ifndef SdFat_h
+#define SdFat_h 1
+
+#include <Arduino.h>
+
+#define O_READ   0x01
+#define O_RDONLY O_READ
+#define O_WRITE  0x02
+#define O_RDWR   (O_READ | O_WRITE)
+#define O_CREAT  0x10
+#define O_TRUNC  0x40
+
+#define HOST_SD_BLOCK    512
+#define HOST_SD_READ_US  1100	// one block at SPI_HALF_SPEED (4 MHz)
+#define HOST_SD_WRITE_US 2500
+#define HOST_SD_DIR_ENTRIES 16	// directory entries per block
+
+class FatFile {
+ public:
+  FatFile() : _index(-1), _pos(0), _next(0) {}
+  bool open(const char *path, uint8_t oflag = O_READ);
+  bool openNext(FatFile *dir, uint8_t oflag = O_READ);
+  bool close() { _index = -1; return true; }
+  int read(void *buf, size_t count);
+  int read();
+  size_t write(const void *buf, size_t count);
+  bool seekSet(uint32_t pos);
+  uint32_t curPosition() const { return _pos; }
+  uint32_t fileSize() const;
+  uint16_t dirIndex() const { return (uint16_t)_index; }
+  bool getSFN(char *name);
+  bool isOpen() const { return _index != -1; }
+  bool isFile() const { return _index >= 0; }
+  bool isDir() const { return _index == ROOT; }
+  void rewind() { _pos = 0; _next = 0; }
+
+ private:
+  friend class SdFat;
+  enum { ROOT = -2 };
+  int _index;			// directory entry, or ROOT, or -1 if closed
+  uint32_t _pos;
+  int _next;			// directory: entry openNext() looks at next
+};
+class SdBaseFile : public FatFile {};
+class SdFile : public SdBaseFile {};
+
+class SdFat {
+ public:
+  bool begin(uint8_t csPin, uint8_t spiSpeed);
+  void initErrorHalt() {}
+  bool exists(const char *path);
+  SdBaseFile *vwd() { return &_root; }
+
+ private:
+  SdBaseFile _root;
+};
+
+// Setting up the card (host.cpp). Tracks are added in directory order;
+// hostSdAddFiller() puts unrelated files before the next ones.
+void hostSdClear();
+void hostSdAddTrack(int trackNumber, uint32_t size, uint32_t tagSize = 0);
+void hostSdAddFiller(int count);
+unsigned long hostSdBlockReads();
+unsigned long hostSdBlockWrites();
+
+#endif
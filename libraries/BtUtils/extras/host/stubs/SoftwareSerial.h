@@ -0,0 +1,21 @@
+/* -*-C++-*-
+ * Stand-in for the Arduino SoftwareSerial library: counts what's sent,
+ * and takes the time that sending it at the baud rate would.
+ */
+
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h 1
+
+#include <Arduino.h>
+
+class SoftwareSerial {
+ public:
+  SoftwareSerial(uint8_t rxPin, uint8_t txPin, bool inverse = false)
+    : baud(9600), bytesSent(0) { (void)rxPin; (void)txPin; (void)inverse; }
+  void begin(long speed) { baud = speed; }
+  size_t write(uint8_t c);
+  long baud;
+  unsigned long bytesSent;
+};
+
+#endif
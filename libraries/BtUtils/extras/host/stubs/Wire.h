@@ -0,0 +1,20 @@
+/* -*-C++-*-
+ * Stand-in for the Arduino Wire (I2C) library: it only keeps the bus
+ * clock, which the MPR121 mock uses to work out how long a transfer takes.
+ */
+
+#ifndef Wire_h
+#define Wire_h 1
+
+#include <Arduino.h>
+
+class TwoWire {
+ public:
+  TwoWire() : clock(100000) {}
+  void begin() {}
+  void setClock(uint32_t frequency) { clock = frequency; }
+  uint32_t clock;
+};
+extern TwoWire Wire;
+
+#endif
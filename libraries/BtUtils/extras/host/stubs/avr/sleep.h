@@ -0,0 +1,12 @@
+/* Stand-in for <avr/sleep.h>: sleep_mode() waits on the virtual clock for
+ * the next timer tick, which is what wakes the ATmega32U4 from idle sleep,
+ * and counts the time as asleep (see hostSleepMicros in ../../host.h). */
+
+#ifndef avr_sleep_h
+#define avr_sleep_h 1
+
+#define SLEEP_MODE_IDLE 0
+inline void set_sleep_mode(int mode) { (void)mode; }
+void sleep_mode();
+
+#endif
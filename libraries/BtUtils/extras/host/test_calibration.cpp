@@ -0,0 +1,83 @@
+/* -*-C++-*-
+ * Auto-calibration: a touch that comes during a recalibration is still
+ * reported, and only the thresholds that change are written (each write
+ * stops and restarts the MPR121).
+ */
+
+#include "host.h"
+
+#define LOOP_REST 200		// microseconds the rest of the loop takes
+#define RECALIBRATE_MINUTES 1
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void runFor(BtUtils *bt, unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    int pin;
+    HOST_CHECK(bt->getPinTouchStatus(&pin) == TOUCH_NO_CHANGE);
+    bt->doTimerTasks();
+    hostAdvance(LOOP_REST);
+  }
+}
+
+static void testTouchDuringRecalibration(BtUtils *bt) {
+
+  // Up to the start of a recalibration, then a touch that lands between
+  // getPinTouchStatus() and doTimerTasks(), so the recalibration's read
+  // is the one that finds it.
+
+  runFor(bt, RECALIBRATE_MINUTES * 60000UL + 50);
+  int pin;
+  HOST_CHECK(bt->getPinTouchStatus(&pin) == TOUCH_NO_CHANGE);
+  bt->updateTouchState();
+  hostTouchPins(PIN_BIT(3));
+  hostAdvance(20000);
+  bt->doTimerTasks();
+  HOST_CHECK(bt->isPinTouched(3));
+
+  HOST_CHECK(bt->getPinTouchStatus(&pin) == NEW_TOUCH);
+  HOST_CHECK(pin == 3);
+  HOST_CHECK(bt->updateTouchState());
+  HOST_CHECK(bt->getNewTouches() == PIN_BIT(3));
+
+  hostTouchPins(0);
+  hostAdvance(20000);
+  HOST_CHECK(bt->getPinTouchStatus(&pin) == NEW_RELEASE);
+  HOST_CHECK(pin == 3);
+  runFor(bt, 100);
+}
+
+static void testThresholdWrites(BtUtils *bt) {
+
+  // A recalibration that finds the same noise writes nothing.
+
+  MPR121.resetCounters();
+  runFor(bt, RECALIBRATE_MINUTES * 60000UL + 1000);
+  HOST_CHECK(MPR121.restarts == 0);
+
+  // New thresholds are written once each, not set for all the pins and
+  // then set again for the calibrated ones.
+
+  MPR121.resetCounters();
+  bt->setTouchReleaseThreshold(50, 25);
+  HOST_CHECK(MPR121.restarts == 2 * PINS_PER_SENSOR);
+  for (uint8_t e = 0; e < PINS_PER_SENSOR; e++) {
+    HOST_CHECK(MPR121.getTouchThreshold(e) == 50);
+    HOST_CHECK(MPR121.getReleaseThreshold(e) == 25);
+  }
+
+  MPR121.resetCounters();
+  bt->setTouchReleaseThreshold(50, 25);
+  HOST_CHECK(MPR121.restarts == 0);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  bt->autoCalibrate(RECALIBRATE_MINUTES);
+
+  testTouchDuringRecalibration(bt);
+  testThresholdWrites(bt);
+  return hostResult("test_calibration");
+}
@@ -0,0 +1,82 @@
+/* -*-C++-*-
+ * Touch events: pollTouchEvent() reports every touch and release, even
+ * when another read (updateTouchState(), a proximity scan) saw them first,
+ * and even when more come than the queue holds.
+ */
+
+#include "host.h"
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void sense(PinSet pins) {
+  hostTouchPins(pins);
+  hostAdvance(20000);
+}
+
+static void expectEvent(BtUtils *bt, int status, int pin) {
+  int changed = -1;
+  HOST_CHECK(bt->pollTouchEvent(&changed) == status);
+  HOST_CHECK(changed == pin);
+}
+
+static void testTapReadElsewhere(BtUtils *bt) {
+
+  // A quick tap whose touch and release are both read by
+  // updateTouchState() between two polls
+
+  sense(PIN_BIT(5));
+  bt->updateTouchState();
+  sense(0);
+  bt->updateTouchState();
+  expectEvent(bt, NEW_TOUCH, 5);
+  expectEvent(bt, NEW_RELEASE, 5);
+  expectEvent(bt, TOUCH_NO_CHANGE, -1);
+
+  // The same, read by proximity scans
+
+#if BTUTILS_ENABLE_PROXIMITY
+  sense(PIN_BIT(7));
+  bt->scanProximity(NULL, NULL);
+  sense(0);
+  bt->scanProximity(NULL, NULL);
+  expectEvent(bt, NEW_TOUCH, 7);
+  expectEvent(bt, NEW_RELEASE, 7);
+  expectEvent(bt, TOUCH_NO_CHANGE, -1);
+#endif
+}
+
+static void testOverflow(BtUtils *bt) {
+
+  // More taps than the queue holds: each pin's events still come in
+  // touch, release order, and every pin ends up released.
+
+  for (int pin = 0; pin < 6; pin++) {
+    sense(PIN_BIT(pin));
+    bt->updateTouchState();
+    sense(0);
+    bt->updateTouchState();
+  }
+  PinSet touched = 0;
+  int events = 0;
+  int changed, status;
+  while ((status = bt->pollTouchEvent(&changed)) != TOUCH_NO_CHANGE) {
+    events++;
+    if (status == NEW_TOUCH) {
+      HOST_CHECK(!(touched & PIN_BIT(changed)));
+      touched |= PIN_BIT(changed);
+    } else {
+      HOST_CHECK(touched & PIN_BIT(changed));
+      touched &= ~PIN_BIT(changed);
+    }
+  }
+  HOST_CHECK(events >= BTUTILS_TOUCH_QUEUE_SIZE - 1);
+  HOST_CHECK(touched == 0);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  testTapReadElsewhere(bt);
+  testOverflow(bt);
+  return hostResult("test_events");
+}
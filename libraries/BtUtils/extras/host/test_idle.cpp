@@ -0,0 +1,63 @@
+/* -*-C++-*-
+ * idle() in a hold-to-play sketch: it slows the MPR121 down when nothing
+ * happens, and has it back at full speed while a pin is held, without
+ * losing the touch.
+ */
+
+#include "host.h"
+
+#define LOOP_REST 200		// microseconds the rest of the loop takes
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+static int touches, releases;
+
+static void runFor(BtUtils *bt, unsigned long ms) {
+
+  // Like sketch 2: a touch starts the pin's track, a release stops it.
+
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    int pin;
+    int status = bt->getPinTouchStatus(&pin);
+    if (status == NEW_TOUCH) {
+      touches++;
+      bt->startTrack(pin);
+    } else if (status == NEW_RELEASE) {
+      releases++;
+      bt->stopTrack();
+    }
+    bt->doTimerTasks();
+    bt->idle();
+    hostAdvance(LOOP_REST);
+  }
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+
+  runFor(bt, BTUTILS_IDLE_SLOW_TOUCH + 1000);
+  HOST_CHECK(MPR121.samplePeriodMs() == 32);
+  HOST_CHECK(bt->getTimeAsleep() > BTUTILS_IDLE_SLOW_TOUCH);
+
+  for (int visit = 0; visit < 3; visit++) {
+    touches = releases = 0;
+    hostTouchPins(PIN_BIT(2));
+    runFor(bt, 100);
+    HOST_CHECK(touches == 1);
+    HOST_CHECK(MPR121.samplePeriodMs() == 1);
+    runFor(bt, 5000);
+    HOST_CHECK(releases == 0);		// the restart kept the baseline
+    HOST_CHECK(bt->isPinTouched(2));
+    HOST_CHECK(bt->getPlayerStatus() == IS_PLAYING);
+    HOST_CHECK(MPR121.samplePeriodMs() == 1);
+
+    hostTouchPins(0);
+    runFor(bt, 20);
+    HOST_CHECK(releases == 1);
+    HOST_CHECK(bt->getPlayerStatus() == IS_STOPPED);
+    runFor(bt, BTUTILS_IDLE_SLOW_TOUCH + 1000);
+    HOST_CHECK(MPR121.samplePeriodMs() == 32);
+  }
+  return hostResult("test_idle");
+}
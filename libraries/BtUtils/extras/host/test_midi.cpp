@@ -0,0 +1,43 @@
+/* -*-C++-*-
+ * MIDI mode: playMidiNotes() reads the touch state too, but a sketch
+ * that also uses getPinTouchStatus() or pollTouchEvent() still gets
+ * every touch and release.
+ */
+
+#include "host.h"
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void testSharedTouches(BtUtils *bt) {
+  for (int round = 0; round < 3; round++) {
+    int pin = -1;
+    hostTouchPins(PIN_BIT(4));
+    hostAdvance(20000);
+    bt->playMidiNotes();		// reads the touch first
+    HOST_CHECK(bt->isPinTouched(4));
+    HOST_CHECK(bt->getPinTouchStatus(&pin) == NEW_TOUCH);
+    HOST_CHECK(pin == 4);
+    HOST_CHECK(bt->pollTouchEvent(&pin) == NEW_TOUCH);
+    HOST_CHECK(pin == 4);
+    HOST_CHECK(bt->pollTouchEvent(&pin) == TOUCH_NO_CHANGE);
+
+    hostTouchPins(0);
+    hostAdvance(20000);
+    bt->playMidiNotes();
+    HOST_CHECK(!bt->isPinTouched(4));
+    HOST_CHECK(bt->getPinTouchStatus(&pin) == NEW_RELEASE);
+    HOST_CHECK(pin == 4);
+    HOST_CHECK(bt->pollTouchEvent(&pin) == NEW_RELEASE);
+    HOST_CHECK(pin == 4);
+    HOST_CHECK(bt->pollTouchEvent(&pin) == TOUCH_NO_CHANGE);
+  }
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  bt->startMidiMode();
+
+  testSharedTouches(bt);
+  return hostResult("test_midi");
+}
@@ -0,0 +1,123 @@
+/* -*-C++-*-
+ * Track positions: getCurrentTrackLocation() counts from the start of
+ * the track, including after startTrack() skips part way in, and stands
+ * still while the track is paused, however it was paused.
+ */
+
+#include "host.h"
+
+#define SLACK 150		// ms: the seek waits for the decoder, reads, ...
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void runFor(BtUtils *bt, unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    bt->doTimerTasks();
+    hostAdvance(1000);
+  }
+}
+
+static bool near(uint32_t location, uint32_t expected) {
+  return location + SLACK >= expected && location <= expected + SLACK;
+}
+
+static void testFromStart(BtUtils *bt) {
+  bt->startTrack(0);
+  runFor(bt, 3000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 3000));
+  bt->stopTrack();
+  HOST_CHECK(bt->getCurrentTrackLocation() == 0);
+}
+
+static void testSeek(BtUtils *bt) {
+
+  // Until the skip is done the location is where it's going; after it,
+  // the decoder's own position, which skipTo() set to the location.
+
+  bt->startTrack(1, 10000);
+  HOST_CHECK(bt->getCurrentTrackLocation() == 10000);
+  runFor(bt, 2000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 12000));
+  runFor(bt, 3000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 15000));
+
+  // A second seek in the same track doesn't add to the first
+
+  bt->startTrack(1, 5000);
+  runFor(bt, 2000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 7000));
+  bt->stopTrack();
+}
+
+static void testPauseResume(BtUtils *bt) {
+  bt->startTrack(2);
+  runFor(bt, 2000);
+  bt->pauseTrack();
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 2000));
+  runFor(bt, 5000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 2000));
+  bt->resumeTrack();
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 3000));
+
+  // After a seek, too
+
+  bt->startTrack(2, 30000);
+  runFor(bt, 1000);
+  bt->pauseTrack();
+  runFor(bt, 5000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 31000));
+  bt->resumeTrack();
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 32000));
+  bt->stopTrack();
+}
+
+static void testPauseBeforeSeek(BtUtils *bt) {
+
+  // Paused before the skip could be done: the track starts over at the
+  // location when it's resumed.
+
+  bt->startTrack(3, 20000);
+  bt->pauseTrack();
+  HOST_CHECK(bt->getCurrentTrackLocation() == 20000);
+  runFor(bt, 3000);
+  HOST_CHECK(bt->getCurrentTrackLocation() == 20000);
+  bt->resumeTrack();
+  runFor(bt, 2000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 22000));
+  bt->stopTrack();
+}
+
+#if BTUTILS_ENABLE_FADES
+static void testPauseWithFade(BtUtils *bt) {
+
+  // The track carries on during the fade-out, then stands still
+
+  bt->setFadeOutTime(500);
+  bt->startTrack(4);
+  runFor(bt, 2000);
+  bt->pauseTrack();
+  runFor(bt, 1000);
+  uint32_t paused = bt->getCurrentTrackLocation();
+  HOST_CHECK(near(paused, 2500));
+  runFor(bt, 3000);
+  HOST_CHECK(bt->getCurrentTrackLocation() == paused);
+  bt->setFadeOutTime(0);
+  bt->stopTrack();
+}
+#endif
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  testFromStart(bt);
+  testSeek(bt);
+  testPauseResume(bt);
+  testPauseBeforeSeek(bt);
+#if BTUTILS_ENABLE_FADES
+  testPauseWithFade(bt);
+#endif
+  return hostResult("test_position");
+}
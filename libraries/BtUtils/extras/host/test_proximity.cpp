@@ -0,0 +1,127 @@
+/* -*-C++-*-
+ * getProximityPinStatus(): the first pin the hand comes near wins at
+ * once; after that another pin only takes over once it has been closer
+ * by more than the margin for the whole dwell time, and never with
+ * lock-on.
+ */
+
+#include "host.h"
+
+#define LOOP_REST 1000		// microseconds the rest of the loop takes
+#define MARGIN 10		// percent
+#define DWELL 100		// ms
+#define PERCENT(p) ((p) / 2)	// delta for a proximity, with a multiplier of 1
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+static int activePin = -1;
+static int switches;		// NEW_TOUCHes and NEW_RELEASEs
+static unsigned long switchedAt;
+
+static void runFor(BtUtils *bt, unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    int pin;
+    int status = bt->getProximityPinStatus(&pin);
+    if (status != TOUCH_NO_CHANGE) {
+      switches++;
+      switchedAt = millis();
+      activePin = (status == NEW_TOUCH) ? pin : -1;
+    }
+    hostAdvance(LOOP_REST);
+  }
+}
+
+static void testClosestWins(BtUtils *bt) {
+
+  // Nothing near, then the hand comes near one pin, a little nearer to
+  // another, and goes away again
+
+  runFor(bt, 500);
+  HOST_CHECK(switches == 0 && activePin == -1);
+  hostSetProximity(1, PERCENT(40));
+  hostSetProximity(2, PERCENT(20));
+  runFor(bt, 50);
+  HOST_CHECK(switches == 1 && activePin == 1);
+  hostSetProximity(0, 0);
+  hostSetProximity(1, 0);
+  hostSetProximity(2, 0);
+  runFor(bt, 50);
+  HOST_CHECK(switches == 2 && activePin == -1);
+  switches = 0;
+}
+
+static void testHysteresis(BtUtils *bt) {
+  hostSetProximity(3, PERCENT(40));
+  runFor(bt, 50);
+  HOST_CHECK(activePin == 3);
+
+  // Closer, but not by more than the margin: stays put however long
+
+  hostSetProximity(4, PERCENT(40 + MARGIN));
+  runFor(bt, 10 * DWELL);
+  HOST_CHECK(switches == 1 && activePin == 3);
+
+  // Past the margin, but not for the whole dwell time: the clock starts
+  // again when it drops back within it
+
+  hostSetProximity(4, PERCENT(40 + MARGIN + 4));
+  runFor(bt, DWELL / 2);
+  hostSetProximity(4, PERCENT(40 + MARGIN));
+  runFor(bt, 10);
+  hostSetProximity(4, PERCENT(40 + MARGIN + 4));
+  unsigned long crossed = millis();
+  runFor(bt, DWELL / 2 + 20);
+  HOST_CHECK(switches == 1 && activePin == 3);
+
+  // Past it for the whole dwell time
+
+  runFor(bt, DWELL);
+  HOST_CHECK(switches == 2 && activePin == 4);
+  HOST_CHECK(switchedAt - crossed >= DWELL);
+
+  // Now it's pin 3 that has to be closer by more than the margin
+
+  hostSetProximity(3, PERCENT(40 + MARGIN + 4 + MARGIN));
+  runFor(bt, 10 * DWELL);
+  HOST_CHECK(switches == 2 && activePin == 4);
+
+  hostSetProximity(3, 0);
+  hostSetProximity(4, 0);
+  runFor(bt, 50);
+  HOST_CHECK(switches == 3 && activePin == -1);
+  switches = 0;
+}
+
+static void testLockOn(BtUtils *bt) {
+  bt->setProximitySwitching(MARGIN, DWELL, true);
+  hostSetProximity(5, PERCENT(20));
+  runFor(bt, 50);
+  HOST_CHECK(activePin == 5);
+  hostSetProximity(6, PERCENT(100));
+  runFor(bt, 10 * DWELL);
+  HOST_CHECK(switches == 1 && activePin == 5);
+
+  // Once the hand leaves the locked pin, the closest one takes over
+
+  hostSetProximity(5, 0);
+  runFor(bt, 50);
+  HOST_CHECK(switches == 2 && activePin == 6);
+  hostSetProximity(6, 0);
+  runFor(bt, 50);
+  HOST_CHECK(activePin == -1);
+  bt->setProximitySwitching(MARGIN, DWELL);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  bt->setProximitySensingMode();
+  bt->setProximityFilter(PROXIMITY_FILTER_NONE, 0);
+  bt->setProximityMultiplier(1);
+  bt->setProximitySwitching(MARGIN, DWELL);
+
+  testClosestWins(bt);
+  testHysteresis(bt);
+  testLockOn(bt);
+  return hostResult("test_proximity");
+}
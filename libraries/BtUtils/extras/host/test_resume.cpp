@@ -0,0 +1,129 @@
+/* -*-C++-*-
+ * Resume: resumeOrStartTrack() in each resume mode, the idle expiry, and
+ * the saved locations' trip to RESUME.DAT and back, written no more often
+ * than asked.
+ */
+
+#include "host.h"
+
+#define SLACK 150		// ms: the seek waits for the decoder, reads, ...
+#define SAVE_INTERVAL 60	// seconds between RESUME.DAT writes
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+static void runFor(BtUtils *bt, unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    bt->doTimerTasks();
+    hostAdvance(1000);
+  }
+}
+
+static bool near(uint32_t location, uint32_t expected) {
+  return location + SLACK >= expected && location <= expected + SLACK;
+}
+
+// A visitor holds a pin for a while, then lets go
+static void visit(BtUtils *bt, int pin, unsigned long ms) {
+  bt->resumeOrStartTrack(pin);
+  runFor(bt, ms);
+  bt->pauseTrack();
+}
+
+static void testSingle(BtUtils *bt) {
+
+  // Only the track that was paused last resumes
+
+  bt->setResumeMode(RESUME_SINGLE);
+  visit(bt, 2, 2000);
+  bt->resumeOrStartTrack(2);
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 3000));
+  bt->pauseTrack();
+  visit(bt, 3, 1000);
+  bt->resumeOrStartTrack(2);
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 1000));
+  bt->stopTrack();
+}
+
+static void testEachTrack(BtUtils *bt) {
+  bt->setResumeMode(RESUME_EACH_TRACK);
+  bt->forgetSavedTrackLocations();
+  bt->saveTrackLocationsToSD(SAVE_INTERVAL);
+  unsigned long writes = hostSdBlockWrites();
+
+  visit(bt, 0, 3000);
+  visit(bt, 1, 2000);
+  HOST_CHECK(near(bt->getSavedTrackLocation(0), 3000));
+  HOST_CHECK(near(bt->getSavedTrackLocation(1), 2000));
+
+  // Back to the first: it carries on from 3 s, wherever the other got to
+
+  bt->resumeOrStartTrack(0);
+  HOST_CHECK(bt->getCurrentTrackLocation() == bt->getSavedTrackLocation(0));
+  runFor(bt, 2000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 5000));
+  bt->pauseTrack();
+  HOST_CHECK(near(bt->getSavedTrackLocation(0), 5000));
+
+  // Nothing is written until the interval is up, then once
+
+  HOST_CHECK(hostSdBlockWrites() == writes);
+  runFor(bt, SAVE_INTERVAL * 1000UL);
+  HOST_CHECK(hostSdBlockWrites() > writes);
+  writes = hostSdBlockWrites();
+  runFor(bt, SAVE_INTERVAL * 1000UL);
+  HOST_CHECK(hostSdBlockWrites() == writes);	// nothing changed
+
+  SdFile file;
+  uint8_t header[4];
+  uint32_t locations[NUM_PINS];
+  HOST_CHECK(file.open("RESUME.DAT", O_READ));
+  HOST_CHECK(file.read(header, sizeof(header)) == sizeof(header));
+  HOST_CHECK(header[0] == 'B' && header[1] == 'T' && header[2] == 'R' && header[3] == NUM_PINS);
+  HOST_CHECK(file.read(locations, sizeof(locations)) == sizeof(locations));
+  file.close();
+  HOST_CHECK(near(locations[0], 5000));
+  HOST_CHECK(near(locations[1], 2000));
+  HOST_CHECK(locations[2] == 0);
+
+  // The power goes off: the locations come back from the card
+
+  bt->forgetSavedTrackLocations();
+  HOST_CHECK(bt->getSavedTrackLocation(1) == 0);
+  bt->saveTrackLocationsToSD(SAVE_INTERVAL);
+  HOST_CHECK(near(bt->getSavedTrackLocation(0), 5000));
+  HOST_CHECK(near(bt->getSavedTrackLocation(1), 2000));
+  bt->resumeOrStartTrack(1);
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 3000));
+  bt->pauseTrack();
+}
+
+static void testIdleExpiry(BtUtils *bt) {
+
+  // A track left longer ago than startOverAfterNoTouchTime() starts over
+
+  bt->setResumeMode(RESUME_EACH_TRACK);
+  bt->startOverAfterNoTouchTime(10);
+  visit(bt, 4, 2000);
+  runFor(bt, 5000);
+  HOST_CHECK(near(bt->getSavedTrackLocation(4), 2000));
+  runFor(bt, 6000);
+  HOST_CHECK(bt->getSavedTrackLocation(4) == 0);
+  bt->resumeOrStartTrack(4);
+  runFor(bt, 1000);
+  HOST_CHECK(near(bt->getCurrentTrackLocation(), 1000));
+  bt->stopTrack();
+  bt->startOverAfterNoTouchTime(-1);
+}
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  testSingle(bt);
+  testEachTrack(bt);
+  testIdleExpiry(bt);
+  return hostResult("test_resume");
+}
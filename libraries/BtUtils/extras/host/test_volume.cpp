@@ -0,0 +1,139 @@
+/* -*-C++-*-
+ * The volume table against the formula it was made from, and fades
+ * against the table: what the MP3 player is actually told. Also when a
+ * fade holds up switching tracks.
+ */
+
+#include "host.h"
+
+static SdFat sd;
+static SFEMP3Shield MP3player;
+
+// The formula in BtUtils.cpp that volumePctToByteTable[] was made with
+static int volumeByte(int percent) {
+  double p = percent / 100.0;
+  p = (1 - (1 / (pow(10.0 * (p + 0.1), 1.5)))) / 0.974;
+  return (uint8_t)((1.0 - p) * 254.0);
+}
+
+static void settle(BtUtils *bt) {
+
+  // Long enough for a held-back volume write to be sent
+
+  hostAdvance(50000);
+  bt->doTimerTasks();
+}
+
+static void testTable(BtUtils *bt) {
+  for (int percent = 0; percent <= 100; percent++) {
+    bt->setVolume(percent, 100 - percent);
+    settle(bt);
+    int left = MP3player.volumeLeft;
+    int right = MP3player.volumeRight;
+    HOST_CHECK(abs(left - volumeByte(percent)) <= 1);
+    HOST_CHECK(abs(right - volumeByte(100 - percent)) <= 1);
+  }
+  bt->setVolume(0);
+  settle(bt);
+  HOST_CHECK(MP3player.volumeLeft == 254);
+  bt->setVolume(100);
+  settle(bt);
+  HOST_CHECK(MP3player.volumeLeft == 0);
+}
+
+static void testHeldBack(BtUtils *bt) {
+
+  // A change that comes right after another is held back, and gets to
+  // the MP3 player when it's due, whether it's sent by doTimerTasks() or
+  // by the sketch setting the same volume again (as sketches do every
+  // time through the loop).
+
+  settle(bt);
+  bt->setVolume(30);
+  bt->setVolume(60);
+  HOST_CHECK(MP3player.volumeLeft == volumeByte(30));
+  for (int ms = 0; ms < 20; ms++) {
+    hostAdvance(1000);
+    bt->setVolume(60);
+  }
+  HOST_CHECK(MP3player.volumeLeft == volumeByte(60));
+
+  settle(bt);
+  bt->setVolume(10);
+  bt->setVolume(0);
+  HOST_CHECK(MP3player.volumeLeft == volumeByte(10));
+  hostAdvance(20000);
+  bt->doTimerTasks();
+  HOST_CHECK(MP3player.volumeLeft == volumeByte(0));
+}
+
+#if BTUTILS_ENABLE_FADES
+static void testFades(BtUtils *bt) {
+
+  // Every curve goes one way only, and ends exactly at the target.
+
+  for (int curve = FADE_CURVE_LINEAR; curve <= FADE_CURVE_EQUAL_POWER; curve++) {
+    bt->setFadeCurve(curve);
+    bt->setVolume(0);
+    settle(bt);
+    bt->fadeToVolume(80, 1000);
+    int last = MP3player.volumeLeft;
+    unsigned long writes = MP3player.volumeWrites;
+    for (int ms = 0; ms < 1200; ms++) {
+      hostAdvance(1000);
+      bt->doTimerTasks();
+      HOST_CHECK(MP3player.volumeLeft <= last);	// a smaller byte is louder
+      last = MP3player.volumeLeft;
+    }
+    HOST_CHECK(MP3player.volumeWrites - writes > 10);
+    HOST_CHECK(last == volumeByte(80));
+    bt->fadeToVolume(10, 1000);
+    for (int ms = 0; ms < 1200; ms++) {
+      hostAdvance(1000);
+      bt->doTimerTasks();
+      HOST_CHECK(MP3player.volumeLeft >= last);
+      last = MP3player.volumeLeft;
+    }
+    HOST_CHECK(last == volumeByte(10));
+  }
+}
+
+static void testSwitchFade(BtUtils *bt) {
+
+  // A fade-out time alone doesn't hold up switching tracks; a switch fade
+  // time fades the old track out first.
+
+  bt->setFadeCurve(FADE_CURVE_LINEAR);
+  bt->setFadeOutTime(500);
+  bt->setVolume(80);
+  settle(bt);
+  bt->startTrack(0);
+  settle(bt);
+  bt->startTrack(1);
+  HOST_CHECK(MP3player.track == 1);
+
+  bt->setSwitchFadeTime(300);
+  bt->startTrack(2);
+  HOST_CHECK(MP3player.track == 1);
+  for (int ms = 0; ms < 400; ms++) {
+    hostAdvance(1000);
+    bt->doTimerTasks();
+  }
+  HOST_CHECK(MP3player.track == 2);
+
+  bt->setSwitchFadeTime(0);
+  bt->setFadeOutTime(0);
+  bt->stopTrack();
+}
+#endif
+
+int main() {
+  BtUtils *bt = BtUtils::setup(&sd, &MP3player);
+  testTable(bt);
+  testHeldBack(bt);
+#if BTUTILS_ENABLE_FADES
+  testFades(bt);
+  testSwitchFade(bt);
+#endif
+  return hostResult("test_volume");
+}